@@ -0,0 +1,396 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Python bindings for libpsa. Points are passed as any C-contiguous buffer of
+// shape (N,2) and type float32, e.g. a NumPy array, which is analyzed in place
+// with the GIL released. Results are returned as NumPy arrays that take over
+// the memory of the analysis without copying.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include "psa.h"
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+
+// Owns a float array of one or two dimensions and exposes it through the
+// buffer protocol
+struct FloatBuffer {
+    PyObject_HEAD
+    float *data;
+    int ndim;
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+};
+
+static void FloatBufferDealloc(FloatBuffer *self)
+{
+    if (self->data) delete[] self->data;
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static int FloatBufferGet(FloatBuffer *self, Py_buffer *view, int flags)
+{
+    view->obj = (PyObject *) self;
+    view->buf = self->data;
+    view->len = self->shape[0] * (self->ndim > 1 ? self->shape[1] : 1) *
+                sizeof(float);
+    view->readonly = 0;
+    view->itemsize = sizeof(float);
+    view->format = (flags & PyBUF_FORMAT) ? (char *) "f" : NULL;
+    view->ndim = self->ndim;
+    view->shape = self->shape;
+    view->strides = self->strides;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    Py_INCREF(self);
+    return 0;
+}
+
+static PyBufferProcs FloatBufferProcs = {
+    (getbufferproc) FloatBufferGet, NULL
+};
+
+static PyTypeObject FloatBufferType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+};
+
+static PyObject *numpy = NULL;
+
+// Wraps the data as a NumPy array, or as a memoryview if NumPy is missing
+static PyObject *NewArray(float *data, int rows, int cols)
+{
+    FloatBuffer *buf = PyObject_New(FloatBuffer, &FloatBufferType);
+    if (!buf) {
+        delete[] data;
+        return NULL;
+    }
+    buf->data = data;
+    buf->ndim = cols > 0 ? 2 : 1;
+    buf->shape[0] = rows;
+    buf->shape[1] = cols;
+    buf->strides[0] = (cols > 0 ? cols : 1) * sizeof(float);
+    buf->strides[1] = sizeof(float);
+    
+    PyObject *array;
+    if (numpy)
+        array = PyObject_CallMethod(numpy, "asarray", "O", (PyObject *) buf);
+    else
+        array = PyMemoryView_FromObject((PyObject *) buf);
+    Py_DECREF(buf);
+    return array;
+}
+
+// Curves become (n,2) arrays of x and y, like the raw output of psa
+static PyObject *CurveArray(const Curve &c)
+{
+    float *data = new float[c.size() * 2];
+    for (int i = 0; i < c.size(); ++i) {
+        data[2*i  ] = c.ToX(i);
+        data[2*i+1] = c[i];
+    }
+    return NewArray(data, c.size(), 2);
+}
+
+
+static const char *MeasureNames[] = {
+    "rp", "rdf", "ani", "periodogram", "spatial", "spectral", "stats", NULL
+};
+
+static bool RequestMeasure(MeasureGraph *graph, const char *name)
+{
+    if (!strcmp(name, "rp")) graph->Request(MeasureRP);
+    else if (!strcmp(name, "rdf")) graph->Request(MeasureRDF);
+    else if (!strcmp(name, "ani")) graph->Request(MeasureAnisotropy);
+    else if (!strcmp(name, "periodogram")) graph->Request(MeasurePeriodogram);
+    else if (!strcmp(name, "spatial")) graph->Request(MeasureSpatialStats);
+    else if (!strcmp(name, "spectral")) graph->Request(MeasureSpectralStats);
+    else if (!strcmp(name, "stats")) {
+        graph->Request(MeasureSpatialStats);
+        graph->Request(MeasureSpectralStats);
+    } else
+        return false;
+    return true;
+}
+
+static bool ParseMeasures(PyObject *measures, MeasureGraph *graph)
+{
+    if (!measures || measures == Py_None) {
+        for (int i = 0; MeasureNames[i]; ++i)
+            RequestMeasure(graph, MeasureNames[i]);
+        return true;
+    }
+    if (PyUnicode_Check(measures)) {
+        PyErr_SetString(PyExc_TypeError, "measures must be a sequence of names");
+        return false;
+    }
+    PyObject *seq = PySequence_Fast(measures, "measures must be a sequence of names");
+    if (!seq)
+        return false;
+    bool ok = true;
+    for (Py_ssize_t i = 0; ok && i < PySequence_Fast_GET_SIZE(seq); ++i) {
+        const char *name = PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(seq, i));
+        if (!name)
+            ok = false;
+        else if (!RequestMeasure(graph, name)) {
+            PyErr_Format(PyExc_ValueError, "unknown measure '%s'", name);
+            ok = false;
+        }
+    }
+    Py_DECREF(seq);
+    return ok;
+}
+
+static bool GetPoints(PyObject *obj, Py_buffer *view)
+{
+    if (PyObject_GetBuffer(obj, view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0)
+        return false;
+    const char *fmt = view->format ? view->format : "B";
+    if (fmt[0] == '<' || fmt[0] == '=' || fmt[0] == '@')
+        ++fmt;
+    if (strcmp(fmt, "f") || view->ndim != 2 || view->shape[1] != 2 ||
+        view->shape[0] < 1 || view->shape[0] > INT_MAX) {
+        PyErr_SetString(PyExc_ValueError,
+                        "points must be a C-contiguous float32 array of shape (N,2)");
+        PyBuffer_Release(view);
+        return false;
+    }
+    return true;
+}
+
+
+struct ContextObject {
+    PyObject_HEAD
+    PsaContext *context;
+    bool busy;
+};
+
+static int ContextInit(ContextObject *self, PyObject *args, PyObject *kwds)
+{
+    static const char *kwlist[] = { "config", NULL };
+    const char *fname = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|z", (char **) kwlist, &fname))
+        return -1;
+    // Another thread may be analyzing with the context, with the GIL released
+    if (self->busy) {
+        PyErr_SetString(PyExc_RuntimeError, "context is in use by another thread");
+        return -1;
+    }
+    // The old context is kept if the config cannot be loaded
+    Config config = DefaultConfig();
+    if (fname) {
+        FILE *fp = fopen(fname, "r");
+        if (!fp) {
+            PyErr_SetFromErrnoWithFilename(PyExc_OSError, fname);
+            return -1;
+        }
+        fclose(fp);
+        std::string error;
+        if (!LoadConfig(fname, &config, &error)) {
+            PyErr_SetString(PyExc_ValueError, error.c_str());
+            return -1;
+        }
+    }
+    if (self->context) delete self->context;
+    self->context = new PsaContext(config);
+    self->busy = false;
+    return 0;
+}
+
+static void ContextDealloc(ContextObject *self)
+{
+    if (self->context) delete self->context;
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+// Out of memory becomes a MemoryError and a failed image sink an OSError,
+// with the description of the context where it has one
+static PyObject *StatusError(int status, const PsaContext &context)
+{
+    PyObject *type = PyExc_ValueError;
+    const char *msg = PsaStatusString(status);
+    if (status == PsaErrorMemory || status == PsaErrorLoad) {
+        type = (status == PsaErrorMemory) ? PyExc_MemoryError : PyExc_OSError;
+        if (!context.Error().empty())
+            msg = context.Error().c_str();
+    } else if (status == PsaErrorImage)
+        type = PyExc_OSError;
+    PyErr_SetString(type, msg);
+    return NULL;
+}
+
+static PyObject *Analyze(PsaContext *context, PyObject *args, PyObject *kwds)
+{
+    static const char *kwlist[] = { "points", "measures", NULL };
+    PyObject *obj, *measures = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|O", (char **) kwlist,
+                                     &obj, &measures))
+        return NULL;
+    MeasureGraph graph;
+    if (!ParseMeasures(measures, &graph))
+        return NULL;
+    Py_buffer view;
+    if (!GetPoints(obj, &view))
+        return NULL;
+    
+    // Point is laid out as two floats, so the buffer is used as it is
+    PsaResult r;
+    int status;
+    Py_BEGIN_ALLOW_THREADS
+    status = context->Analyze(static_cast<const Point *>(view.buf),
+                              (int) view.shape[0], graph, &r);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&view);
+    if (status != PsaOK)
+        return StatusError(status, *context);
+    
+    PyObject *dict = PyDict_New();
+    if (!dict)
+        return NULL;
+    bool ok = true;
+    if (graph.Needs(MeasureSpatialStats) || graph.Needs(MeasureSpectralStats)) {
+        Statistics s = r.stats;
+        NormalizeStatistics(&s, r.npoints);
+        float *data = new float[5];
+        data[0] = s.mindist;
+        data[1] = s.avgmindist;
+        data[2] = s.orientorder;
+        data[3] = s.effnyquist;
+        data[4] = s.oscillations;
+        PyObject *a = NewArray(data, 5, 0);
+        ok = a && PyDict_SetItemString(dict, "stats", a) == 0;
+        Py_XDECREF(a);
+    }
+    const char *names[3] = { "rp", "rdf", "ani" };
+    const Curve *curves[3] = { &r.rp, &r.rdf, &r.ani };
+    for (int i = 0; ok && i < 3; ++i) {
+        if (curves[i]->size() == 0) continue;
+        PyObject *a = CurveArray(*curves[i]);
+        ok = a && PyDict_SetItemString(dict, names[i], a) == 0;
+        Py_XDECREF(a);
+    }
+    if (ok && graph.Needs(MeasurePeriodogram) && r.periodogram.size > 0) {
+        // The array takes over the memory of the periodogram
+        int size = r.periodogram.size;
+        PyObject *a = NewArray(r.periodogram.periodogram, size, size);
+        r.periodogram.periodogram = NULL;
+        ok = a && PyDict_SetItemString(dict, "periodogram", a) == 0;
+        Py_XDECREF(a);
+    }
+    if (!ok) {
+        Py_DECREF(dict);
+        return NULL;
+    }
+    return dict;
+}
+
+static PyObject *ContextAnalyze(ContextObject *self, PyObject *args,
+                                PyObject *kwds)
+{
+    // Context.__new__() without __init__() leaves no context behind
+    if (!self->context) {
+        PyErr_SetString(PyExc_RuntimeError, "context is not initialized");
+        return NULL;
+    }
+    // The context itself is not thread-safe
+    if (self->busy) {
+        PyErr_SetString(PyExc_RuntimeError, "context is in use by another thread");
+        return NULL;
+    }
+    self->busy = true;
+    PyObject *result = Analyze(self->context, args, kwds);
+    self->busy = false;
+    return result;
+}
+
+static PyObject *ModuleAnalyze(PyObject *, PyObject *args, PyObject *kwds)
+{
+    PsaContext context;
+    return Analyze(&context, args, kwds);
+}
+
+#define ANALYZE_DOC \
+    "analyze(points, measures=None)\n\n" \
+    "Analyzes a float32 array of shape (N,2) in the unit torus. measures is a\n" \
+    "sequence of 'rp', 'rdf', 'ani', 'periodogram', 'spatial', 'spectral'\n" \
+    "and 'stats'; all are computed by default. Returns a dict of arrays:\n" \
+    "curves as (n,2) arrays of x and y, the periodogram as a 2D array and\n" \
+    "the statistics in the order of psa.STATISTICS, in the units of psa.\n" \
+    "Invalid points or measures raise ValueError, and measures that do not\n" \
+    "fit in memory at the frange of the config MemoryError."
+
+static PyMethodDef ContextMethods[] = {
+    { "analyze", (PyCFunction) ContextAnalyze, METH_VARARGS | METH_KEYWORDS,
+      ANALYZE_DOC },
+    { NULL, NULL, 0, NULL }
+};
+
+static PyTypeObject ContextType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+};
+
+static PyMethodDef ModuleMethods[] = {
+    { "analyze", (PyCFunction) ModuleAnalyze, METH_VARARGS | METH_KEYWORDS,
+      ANALYZE_DOC },
+    { NULL, NULL, 0, NULL }
+};
+
+static PyModuleDef Module = {
+    PyModuleDef_HEAD_INIT, "psa", "Point set analysis", -1, ModuleMethods
+};
+
+PyMODINIT_FUNC PyInit_psa(void)
+{
+    FloatBufferType.tp_name = "psa.FloatBuffer";
+    FloatBufferType.tp_basicsize = sizeof(FloatBuffer);
+    FloatBufferType.tp_dealloc = (destructor) FloatBufferDealloc;
+    FloatBufferType.tp_as_buffer = &FloatBufferProcs;
+    FloatBufferType.tp_flags = Py_TPFLAGS_DEFAULT;
+    
+    ContextType.tp_name = "psa.Context";
+    ContextType.tp_doc = "Context(config=None)\n\n"
+        "Keeps buffers and tables between analyses of sets of equal size. "
+        "config names a psa configuration file; an unreadable one raises "
+        "OSError and an invalid one ValueError.";
+    ContextType.tp_basicsize = sizeof(ContextObject);
+    ContextType.tp_dealloc = (destructor) ContextDealloc;
+    ContextType.tp_flags = Py_TPFLAGS_DEFAULT;
+    ContextType.tp_methods = ContextMethods;
+    ContextType.tp_init = (initproc) ContextInit;
+    ContextType.tp_new = PyType_GenericNew;
+    
+    if (PyType_Ready(&FloatBufferType) < 0 || PyType_Ready(&ContextType) < 0)
+        return NULL;
+    PyObject *m = PyModule_Create(&Module);
+    if (!m)
+        return NULL;
+    Py_INCREF(&ContextType);
+    PyModule_AddObject(m, "Context", (PyObject *) &ContextType);
+    PyModule_AddObject(m, "STATISTICS", Py_BuildValue("(sssss)",
+        "mindist", "avgmindist", "orientorder", "effnyquist", "oscillations"));
+    
+    numpy = PyImport_ImportModule("numpy");
+    if (!numpy)
+        PyErr_Clear();
+    return m;
+}
@@ -0,0 +1,90 @@
+# Checks of the Python module, run by 'make python'. NumPy is not needed;
+# points are passed as memoryviews of float arrays.
+
+import array
+import os
+import random
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                '..'))
+import psa
+
+
+def points(n, seed=1, typecode='f'):
+    rng = random.Random(seed)
+    vals = array.array(typecode, [rng.random() for i in range(2 * n)])
+    return memoryview(vals).cast('B').cast(typecode, (n, 2))
+
+
+def config(text):
+    f = tempfile.NamedTemporaryFile('w', suffix='.cfg', delete=False)
+    f.write(text)
+    f.close()
+    return f.name
+
+
+def raises(error, f, *args):
+    try:
+        f(*args)
+    except error:
+        return
+    raise AssertionError('%r not raised by %r' % (error, args))
+
+
+def test_buffers():
+    r = psa.analyze(points(256), ['stats', 'rp', 'rdf'])
+    assert set(['rdf', 'rp', 'stats']) <= set(r) and 'ani' not in r
+    assert len(r['stats']) == len(psa.STATISTICS)
+    assert len(r['rp']) > 0 and r['rp'].shape[1] == 2
+    assert 'periodogram' in psa.analyze(points(64), ['periodogram'])
+    # Buffers that are not C-contiguous float32 arrays of shape (N,2)
+    raises(ValueError, psa.analyze, points(64, typecode='d'))
+    raises(ValueError, psa.analyze, memoryview(array.array('f', [0.5] * 6)))
+    # The exporter itself refuses a strided view, NumPy with ValueError
+    raises((ValueError, BufferError), psa.analyze, points(64)[::2])
+    raises(TypeError, psa.analyze, [[0.5, 0.5]])
+
+
+def test_errors():
+    raises(ValueError, psa.analyze, points(64), ['bogus'])
+    raises(TypeError, psa.analyze, points(64), 'rp')
+    raises(OSError, psa.Context, '/nonexistent/psa.cfg')
+    bad = config('engines bogus\n')
+    try:
+        raises(ValueError, psa.Context, bad)
+    finally:
+        os.remove(bad)
+    # A grid whose indices overflow, which is not even allocated
+    huge = config('frange 100000\n')
+    try:
+        ctx = psa.Context(huge)
+        raises(MemoryError, ctx.analyze, points(64), ['rp'])
+        # The context stays usable for measures that fit
+        assert 'rdf' in ctx.analyze(points(64), ['rdf'])
+    finally:
+        os.remove(huge)
+    raises(RuntimeError, psa.Context.__new__(psa.Context).analyze, points(64))
+
+
+def test_reuse():
+    ctx = psa.Context()
+    a = ctx.analyze(points(256), ['stats', 'rp'])
+    b = ctx.analyze(points(512, 2), ['stats', 'rp'])
+    c = ctx.analyze(points(256), ['stats', 'rp'])
+    assert a['stats'].tolist() == c['stats'].tolist()
+    assert a['rp'].tolist() == c['rp'].tolist()
+    assert len(b['rp']) != len(a['rp'])
+    # Reinitializing replaces the configuration, but only if it loads
+    ctx.__init__(None)
+    raises(OSError, ctx.__init__, '/nonexistent/psa.cfg')
+    assert ctx.analyze(points(256), ['stats'])['stats'].tolist() == \
+        a['stats'].tolist()
+
+
+if __name__ == '__main__':
+    for name, test in sorted(globals().items()):
+        if name.startswith('test_'):
+            test()
+    print('python module ok')
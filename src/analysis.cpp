@@ -20,36 +20,206 @@
  */
 
 #include "analysis.h"
+#include "gradient.h"
+#include "measures.h"
 #include "periodogram.h"
+#include "profile.h"
+#include "psa.h"
 #include "result.h"
 #include "spectrum.h"
+#include "stream.h"
+#include "tune.h"
 #include "util.h"
+#include <fstream>
+#include <sstream>
 
 
+// Loads input entries one after another. Consecutive sets of an MPS
+// container are streamed from a single open file instead of reopening it.
+class InputReader
+{
+    PointSetContainer container;
+    std::string current;
+    
+    bool OpenContainer(const std::string &fname) {
+        if (fname == current)
+            return true;
+        if (!container.Open(fname)) {
+            std::cerr << "Cannot load '" << fname << "'.\n";
+            exit(1);
+        }
+        current = fname;
+        return true;
+    }
+    
+public:
+    PointSet Load(const std::string &entry) {
+        std::string fname;
+        int index;
+        if (!PointSet::SplitEntry(entry, &fname, &index))
+            return PointSet::Load(entry);
+        OpenContainer(fname);
+        PointSet set;
+        bool ok = (index == container.Next()) ? container.ReadNext(&set) :
+                                                container.Read(index, &set);
+        if (!ok) {
+            std::cerr << "Cannot load set " << index << " from '"
+                      << fname << "'.\n";
+            exit(1);
+        }
+        return set;
+    }
+    
+    // Containers know their set sizes, so no coordinates are read for them
+    int NumPoints(const std::string &entry) {
+        std::string fname;
+        int index;
+        if (!PointSet::SplitEntry(entry, &fname, &index))
+            return PointSet::Load(entry).size();
+        OpenContainer(fname);
+        return (index < container.NumSets()) ? container.NumPoints(index) : 0;
+    }
+};
+
+static std::string OutputBase(std::string &entry) {
+    std::string fname;
+    int index;
+    if (PointSet::SplitEntry(entry, &fname, &index)) {
+        std::ostringstream oss;
+        oss << BaseName(fname, true) << "_" << index;
+        return oss.str();
+    }
+    return BaseName(entry, true);
+}
+
+// Iterates over all input sets in order. The entry '-' reads a stream of sets
+// from stdin, which is consumed concurrently with the analysis.
+class InputSequence
+{
+    std::vector<std::string> &files;
+    InputReader reader;
+    PointSetStream stream;
+    PointSetStream::Format format;
+    unsigned int pos;
+    int nstreamed;
+    bool streaming;
+    
+public:
+    InputSequence(std::vector<std::string> &files, ParamList &params)
+        : files(files), pos(0), nstreamed(0), streaming(false)
+    {
+        std::string name = params.GetString("stream");
+        if (!PointSetStream::ParseFormat(name, &format)) {
+            std::cerr << "Unknown stream format '" << name << "'.\n";
+            exit(1);
+        }
+    }
+    
+    // Number of sets, or -1 if it is only known once the stream has ended
+    int Size() const {
+        if (std::find(files.begin(), files.end(), "-") != files.end())
+            return -1;
+        return (int) files.size();
+    }
+    
+    bool Next(PointSet *set, std::string *base) {
+        ProfileScope scope("load");
+        for (;;) {
+            if (streaming) {
+                if (stream.Next(set)) {
+                    std::ostringstream oss;
+                    oss << "stdin_" << nstreamed++;
+                    *base = oss.str();
+                    return true;
+                }
+                if (stream.Failed()) {
+                    std::cerr << "Malformed point set " << nstreamed
+                              << " on stdin.\n";
+                    exit(1);
+                }
+                stream.Close();
+                streaming = false;
+                ++pos;
+            } else if (pos >= files.size()) {
+                return false;
+            } else if (files[pos] == "-") {
+                const int capacity = 4;
+                stream.Open(stdin, format, capacity);
+                streaming = true;
+            } else {
+                *set = reader.Load(files[pos]);
+                *base = OutputBase(files[pos]);
+                ++pos;
+                return true;
+            }
+        }
+    }
+};
+
 static int MinNumPoints(std::vector<std::string> &files) {
-    PointSet first = PointSet::Load(files[0]);
-    int npoints = first.size();
+    InputReader reader;
+    int npoints = reader.NumPoints(files[0]);
     bool differing = false;
     for (unsigned int i = 1; i < files.size(); ++i) {
-        PointSet points = PointSet::Load(files[i]);
-        if (points.size() != npoints)
+        int n = reader.NumPoints(files[i]);
+        if (n != npoints)
             differing = true;
-        npoints = std::min(npoints, points.size());
+        npoints = std::min(npoints, n);
     }
     if (differing)
         printf("Analyzing only the first %d points from each file\n", npoints);
     return npoints;
 }
 
-static void AnalyzeParams(ParamList &params, bool *ft, bool *summary) {
-    bool other = !params.GetString("convert").empty() ||
-        params.GetBool("spatial") || params.GetBool("spectral") ||
-        params.GetBool("stats") || params.GetBool("rp") ||
-        params.GetBool("rdf") || params.GetBool("ani") ||
-        params.GetBool("pspectrum");
-    *summary = params.GetBool("summary") || !other;
-    *ft = params.GetBool("rp") || params.GetBool("ani") ||
-          params.GetBool("pspectrum") || *summary;
+// Returns whether any measure or per-file output has been requested
+static bool AnalyzeParams(ParamList &params, MeasureGraph *graph,
+                          bool *summary) {
+    *graph = MeasureGraph::FromParams(params, summary);
+    return !graph->Empty() || !params.GetString("convert").empty();
+}
+
+
+void ExpandContainers(std::vector<std::string> &files)
+{
+    std::vector<std::string> entries;
+    for (unsigned int i = 0; i < files.size(); ++i) {
+        if (!PointSet::IsContainer(files[i])) {
+            entries.push_back(files[i]);
+            continue;
+        }
+        PointSetContainer c;
+        if (!c.Open(files[i])) {
+            std::cerr << "Cannot load '" << files[i] << "'.\n";
+            exit(1);
+        }
+        for (int j = 0; j < c.NumSets(); ++j)
+            entries.push_back(PointSet::EntryName(files[i], j));
+    }
+    files.swap(entries);
+}
+
+void Pack(std::vector<std::string> &files, ParamList &params)
+{
+    const std::string fname = params.GetString("pack");
+    for (unsigned int i = 0; i < files.size(); ++i) {
+        std::string container;
+        int index;
+        if (files[i] == fname || (PointSet::SplitEntry(files[i], &container,
+                                  &index) && container == fname)) {
+            std::cerr << "Cannot pack '" << fname << "' into itself.\n";
+            exit(1);
+        }
+    }
+    
+    PointSetContainer c;
+    InputReader reader;
+    bool ok = c.Create(fname, files.size(), params.GetBool("double"));
+    for (unsigned int i = 0; ok && i < files.size(); ++i)
+        ok = c.Append(reader.Load(files[i]));
+    if (!c.Close() || !ok) {
+        std::cerr << "Cannot create '" << fname << "'.\n";
+        exit(1);
+    }
 }
 
 
@@ -57,155 +227,387 @@ void Analysis(std::vector<std::string> &files, ParamList &params,
               Config &config)
 {
     // Configure variables
-    bool ft, summary;
-    AnalyzeParams(params, &ft, &summary);
+    MeasureGraph graph;
+    bool summary;
+    if (!AnalyzeParams(params, &graph, &summary))
+        return;
     
     Result r;
-    Periodogram p;
+    PsaContext context(config);
+    PsaResult pr;
+    InputSequence input(files, params);
+    ResultWriter writer(config, params, std::max(0, params.GetInt("writers")));
+    std::string base;
     
     // Process files
-    for (unsigned int i = 0; i < files.size(); ++i) {
-        r.points = PointSet::Load(files[i]);
-        
-        const int npoints = r.points.size();
-        const float fnorm = 2.f / sqrtf(npoints);
-        const float rnorm = 1.f / sqrtf(2.f / (SQRT3 * npoints));
-        const int ftsize  = config.frange / fnorm;
-        
-        r.npoints = npoints;
-        r.nsets = 1;
-        
-        // Fourier transform if necessary
-        if (ft) {
-            Spectrum s(ftsize * 2);
-            Spectrum::PointSetSpectrum(&s, r.points, npoints);
-            p = Periodogram(s);
-            p.Divide(npoints);
+    while (input.Next(&r.points, &base)) {
+        // Spectrum images of banded grids are written while they are
+        // computed and skipped by the writer
+        PngStream png(base + "_spec.png");
+        context.SetImageSink(params.GetBool("pspectrum") ? &png : NULL);
+        int status = context.Analyze(r.points, graph, &pr);
+        context.SetImageSink(NULL);
+        if (status != PsaOK) {
+            std::cerr << "Cannot analyze '" << base << "': "
+                      << PsaStatusString(status) << ".\n";
+            exit(1);
         }
+        r.npoints = pr.npoints;
+        r.nsets = 1;
+        r.stats = pr.stats;
+        r.rdf = pr.rdf;
+        r.rdferror = pr.rdferror;
+        r.rp = pr.rp;
+        r.ani = pr.ani;
+        r.spectrum = pr.spectrum;
         
-        // Process params
-        if (params.GetBool("spatial") || params.GetBool("stats") || summary)
-            SpatialStatistics(r.points, npoints, &r.stats);
-        if (params.GetBool("spectral") || params.GetBool("stats") || summary)
-            SpectralStatistics(r.points, npoints, &r.stats);
-        if (params.GetBool("rp") || summary) {
-            int nbins = ftsize * config.fbinsize;
-            r.rp = Curve(nbins, 0, ftsize);
-            p.RadialPower(&r.rp);
-        }
-        if (params.GetBool("rdf") || summary) {
-            float maxdist = config.rrange / rnorm;
-            int nbins = config.rbinsize * npoints;
-            r.rdf = Curve(nbins, 0, maxdist);
-            r.points.RDF(&r.rdf);
-        }
-        if (params.GetBool("ani") || summary) {
-            int nbins = ftsize * config.fbinsize;
-            r.ani = Curve(nbins, 0, ftsize);
-            p.Anisotropy(&r.ani);
-        }
-        if (params.GetBool("pspectrum") || summary) {
-            r.spectrum = Image(ftsize * 2, ftsize * 2);
-            p.ToImage(&r.spectrum);
-            r.spectrum.ToneMap(true);
+        // Output
+        {
+            ProfileScope scope("output");
+            writer.Write(base, r, summary);
         }
+        Profile::SampleMemory();
+    }
+    writer.Finish();
+}
 
-        // Output
-        std::string base = BaseName(files[i], true);
-        if (summary)
-            SaveSummary(base+".pdf", r, config);
-        else
-            WriteResult(base, r, config, params);
+void AnalysisChunked(std::vector<std::string> &files, ParamList &params,
+                     Config &config)
+{
+    MeasureGraph graph;
+    bool summary;
+    if (!AnalyzeParams(params, &graph, &summary))
+        return;
+    if (!params.GetString("convert").empty()) {
+        std::cerr << "Sets read in blocks cannot be converted.\n";
+        exit(1);
+    }
+    
+    const int chunk = params.GetInt("chunk");
+    Result r;
+    PsaContext context(config);
+    PsaResult pr;
+    ResultWriter writer(config, params, std::max(0, params.GetInt("writers")));
+    
+    for (unsigned int i = 0; i < files.size(); ++i) {
+        PointBlockReader reader;
+        if (!reader.Open(files[i])) {
+            std::cerr << "Cannot read '" << files[i] << "' in blocks, only "
+                      << "RPS files and MPS sets can be.\n";
+            exit(1);
+        }
+        std::string base = OutputBase(files[i]);
+        PngStream png(base + "_spec.png");
+        context.SetImageSink(params.GetBool("pspectrum") ? &png : NULL);
+        int status = context.Analyze(reader, chunk, graph, &pr);
+        context.SetImageSink(NULL);
+        if (status != PsaOK) {
+            std::cerr << "Cannot analyze '" << base << "': "
+                      << PsaStatusString(status) << ".\n";
+            exit(1);
+        }
+        r.npoints = pr.npoints;
+        r.nsets = 1;
+        r.stats = pr.stats;
+        r.rdf = pr.rdf;
+        r.rp = pr.rp;
+        r.ani = pr.ani;
+        r.spectrum = pr.spectrum;
+        {
+            ProfileScope scope("output");
+            writer.Write(base, r, summary);
+        }
+        Profile::SampleMemory();
     }
+    writer.Finish();
 }
 
 void AnalysisAverage(std::vector<std::string> &files, ParamList &params,
                      Config &config)
 {
     // Configure variables
-    bool ft, summary;
-    AnalyzeParams(params, &ft, &summary);
-
-    const int npoints = MinNumPoints(files);
+    MeasureGraph graph;
+    bool summary;
+    if (!AnalyzeParams(params, &graph, &summary))
+        return;
+    
+    InputSequence input(files, params);
+    const int nfiles = input.Size();
+    std::string base;
+    PointSet points;
+    if (!input.Next(&points, &base))
+        return;
+    
+    // A stream has to provide at least as many points in every set as in
+    // the first one, since its sizes are not known in advance
+    const int npoints = (nfiles < 0) ? points.size() : MinNumPoints(files);
     const float fnorm = 2.f / sqrtf(npoints);
     const float rnorm = 1.f / sqrtf(2.f / (SQRT3 * npoints));
     const int ftsize = config.frange / fnorm;
     const float maxdist = config.rrange / rnorm;
+    const bool ft = graph.Needs(MeasurePeriodogram);
+    const bool spectral = graph.Needs(MeasureSpectralStats);
+    const bool sampled = config.SampledRDF();
+    const Engines engines =
+        (ft || (graph.Needs(MeasurePairHistogram) && !sampled) ||
+         graph.Needs(MeasureFullRDF)) ?
+        TuneEngines(config, npoints) : ReferenceEngines();
     
     Result r;
-    Periodogram p(ftsize * 2);
+    Periodogram p(ft ? ftsize * 2 : 0);
+    SpectralAverage spectralavg(npoints);
+    spectralavg.SetHankel(engines.hankel);
     
     int nbins = config.rbinsize * npoints;
     r.rdf = Curve(nbins, 0, maxdist);
+    // Variances of the sampled RDFs, which add up over the sets
+    Curve rdfvar = r.rdf;
     r.npoints = npoints;
-    r.nsets = files.size();
+    r.points = points;
     
     // Process files
-    if (ft) PrintProgress("FT", 0);
-    for (unsigned int i = 0; i < files.size(); ++i) {
-        PointSet points = PointSet::Load(files[i]);
-        if (i == 0)
-            r.points = points;
-        
-        // Fourier transform if necessary
-        if (ft) {
-            Spectrum s(ftsize * 2);
-            Spectrum::PointSetSpectrum(&s, points, npoints);
-            p.Accumulate(Periodogram(s));
+    const bool progress = (ft || spectral) && nfiles > 0;
+    if (progress) PrintProgress("Sets", 0);
+    int nsets = 0;
+    do {
+        if (points.size() < npoints) {
+            std::cerr << "Set '" << base << "' has fewer than " << npoints
+                      << " points.\n";
+            exit(1);
         }
         
-        // Accumulate other measures if necessary
-        if (params.GetBool("spatial") || params.GetBool("stats") || summary) {
-            Statistics stats;
-            SpatialStatistics(points, npoints, &stats);
-            r.stats.mindist += stats.mindist;
-            r.stats.avgmindist += stats.avgmindist;
-            r.stats.orientorder += stats.orientorder;
-        }
-        if (params.GetBool("rdf") || summary) {
-            Curve rdf = r.rdf;
-            rdf.SetZero();
-            points.RDF(&rdf);
-            r.rdf.Accumulate(rdf);
+        bool ok = RunStages([&]() {
+            if (ft) {
+                ProfileScope scope("ft");
+                Spectrum s(ftsize * 2);
+                EngineSpectrum(engines, &s, &points.points[0], npoints);
+                p.Accumulate(Periodogram(s));
+            }
+        }, [&]() {
+            if (!graph.Needs(MeasurePairHistogram))
+                return;
+            std::vector<Curve *> rdfs, errors;
+            Curve rdf = r.rdf, fullrdf, error;
+            if (graph.Needs(MeasureRDF)) {
+                rdfs.push_back(&rdf);
+                errors.push_back(&error);
+            }
+            if (graph.Needs(MeasureFullRDF)) {
+                fullrdf = spectralavg.RDFLayout();
+                rdfs.push_back(&fullrdf);
+            }
+            ConfigRDF(config, engines, &points.points[0], points.size(), rdfs,
+                      errors, nsets + 1);
+            for (int i = 0; i < error.size(); ++i)
+                rdfvar[i] += error[i] * error[i];
+            if (graph.Needs(MeasureRDF))
+                r.rdf.Accumulate(rdf);
+            if (spectral) {
+                ProfileScope scope("spectral stats");
+                spectralavg.AddRDF(fullrdf);
+            }
+        }, [&]() {
+            if (graph.Needs(MeasureSpatialStats)) {
+                ProfileScope scope("spatial stats");
+                Statistics stats;
+                SpatialStatistics(points, npoints, &stats);
+                r.stats.mindist += stats.mindist;
+                r.stats.avgmindist += stats.avgmindist;
+                r.stats.orientorder += stats.orientorder;
+            }
+        });
+        if (!ok) {
+            std::cerr << "Not enough memory for the measures.\n";
+            exit(1);
         }
         
-        if (ft) PrintProgress("FT", (i+1) / (float) files.size());
-    }
-    if (ft) std::cout << std::endl;
+        ++nsets;
+        Profile::Count(CounterSets, 1);
+        Profile::SampleMemory();
+        if (progress) PrintProgress("Sets", nsets / (float) nfiles);
+    } while (input.Next(&points, &base));
+    if (progress) std::cout << std::endl;
     
     // Finish
-    r.stats.Divide(files.size());
-    p.Divide(npoints * files.size());
-    r.rdf.Divide(files.size());
+    r.nsets = nsets;
+    r.stats.Divide(nsets);
+    if (ft) p.Divide(npoints * nsets);
+    r.rdf.Divide(nsets);
+    if (sampled && graph.Needs(MeasureRDF)) {
+        r.rdferror = rdfvar;
+        for (int i = 0; i < rdfvar.size(); ++i)
+            r.rdferror[i] = sqrtf(rdfvar[i]) / nsets;
+    }
     
     // Process params
-    if (params.GetBool("spectral") || params.GetBool("stats") || summary) {
-        std::vector<PointSet> sets(files.size());
-        for (unsigned int i = 0; i < files.size(); ++i)
-            sets[i] = PointSet::Load(files[i]);
-        SpectralStatistics(sets, npoints, &r.stats);
-    }
-    if (params.GetBool("rp") || summary) {
+    if (spectral)
+        spectralavg.GetStatistics(&r.stats);
+    if (graph.Needs(MeasureRP)) {
+        ProfileScope scope("rp");
         int nbins = ftsize * config.fbinsize;
         r.rp = Curve(nbins, 0, ftsize);
         p.RadialPower(&r.rp);
     }
-    if (params.GetBool("ani") || summary) {
-        int nbins = ftsize * config.fbinsize;
-        r.ani = Curve(nbins, 0, ftsize);
-        p.Anisotropy(&r.ani);
+    if (graph.Needs(MeasureAnisotropy)) {
+        ProfileScope scope("ani");
+        r.ani = Curve(r.rp.size(), 0, ftsize);
+        p.Anisotropy(&r.ani, r.rp);
     }
-    if (params.GetBool("pspectrum") || summary) {
+    if (graph.Needs(MeasureImage)) {
+        ProfileScope scope("image");
         r.spectrum = Image(ftsize * 2, ftsize * 2);
         p.ToImage(&r.spectrum);
         r.spectrum.ToneMap(true);
     }
 
     // Output
-    std::string base = "avg";
+    base = "avg";
     if (summary)
         SaveSummary(base+".pdf", r, config);
     else
         WriteResult(base, r, config, params);
 }
 
+// Scores every set by the loss of its smoothed RDF against a target curve,
+// e.g. one written by --rdf --raw for sets of the same size, and by the RMS
+// of the gradient that an optimizer would follow
+void ScoreRDF(std::vector<std::string> &files, ParamList &params)
+{
+    RDFTarget target;
+    target.rdf = Curve::Load(params.GetString("rdf-target"));
+    target.sigma = std::max(params.GetFloat("rdf-sigma", 0.f), 0.f);
+    
+    InputSequence input(files, params);
+    PointSet points;
+    std::string base;
+    bool header = true;
+    while (input.Next(&points, &base)) {
+        const int npoints = points.size();
+        std::vector<float> gradient(2 * npoints);
+        float loss = 0.f;
+        double rms = 0.0;
+        if (npoints > 0) {
+            loss = RDFLoss(&points.points[0], npoints, target, &gradient[0]);
+            for (int i = 0; i < 2 * npoints; ++i)
+                rms += gradient[i] * gradient[i];
+            rms = sqrt(rms / npoints);
+        }
+        if (header)
+            printf("%-16s\tRDF loss\tGrad. RMS\n", "File");
+        header = false;
+        printf("%-16s\t%.6g\t%.6g\n", base.c_str(), loss, rms);
+        Profile::SampleMemory();
+    }
+}
+
+// The window is given as cx,cy,width,height in the units of frange, the step
+// in integer frequencies of the set
+void SpectrumWindows(std::vector<std::string> &files, ParamList &params,
+                     Config &config)
+{
+    std::vector<std::string> spec = SplitList(params.GetString("window"));
+    const float step = params.GetFloat("wstep", 1.f);
+    if (spec.size() != 4 || step <= 0.f) {
+        std::cerr << "Invalid window '" << params.GetString("window")
+                  << "'.\n";
+        exit(1);
+    }
+    float w[4];
+    for (int i = 0; i < 4; ++i)
+        w[i] = atof(spec[i].c_str());
+    const bool raw = params.GetBool("raw");
+    
+    InputSequence input(files, params);
+    PointSet points;
+    std::string base;
+    while (input.Next(&points, &base)) {
+        const int npoints = points.size();
+        if (npoints == 0)
+            continue;
+        const float fnorm = 2.f / sqrtf(npoints);
+        SpectrumWindow window(w[0] / fnorm, w[1] / fnorm, w[2] / fnorm,
+                              w[3] / fnorm, step);
+        {
+            ProfileScope scope("window");
+            SpectrumWindow::PointSetSpectrum(&window, &points.points[0],
+                                             npoints, config.engines.ft);
+        }
+        
+        Image image(window.nx, window.ny);
+        for (int y = 0; y < window.ny; ++y)
+            for (int x = 0; x < window.nx; ++x)
+                image.SetPixel(x, y, window.Power(x, y) / npoints);
+        image.ToneMap(true);
+        image.Save(base+"_window.png");
+        if (raw) {
+            FILE *fp = fopen((base+"_window.txt").c_str(), "w");
+            if (!fp) {
+                std::cerr << "Cannot create '" << base << "_window.txt'.\n";
+                exit(1);
+            }
+            for (int y = 0; y < window.ny; ++y)
+                for (int x = 0; x < window.nx; ++x)
+                    fprintf(fp, "%g %g %g\n", window.FrequencyX(x) * fnorm,
+                            window.FrequencyY(y) * fnorm,
+                            window.Power(x, y) / npoints);
+            fclose(fp);
+        }
+        Profile::SampleMemory();
+    }
+}
+
+// The query file lists one frequency vector x y per line in the units of
+// frange; lines starting with # are skipped
+void SpectrumQueries(std::vector<std::string> &files, ParamList &params)
+{
+    const std::string fname = params.GetString("query");
+    std::ifstream in(fname.c_str());
+    if (!in) {
+        std::cerr << "Cannot load '" << fname << "'.\n";
+        exit(1);
+    }
+    std::vector<Point> query;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream is(line);
+        Point f;
+        if (line.empty() || line[0] == '#')
+            continue;
+        if (!(is >> f.x >> f.y)) {
+            std::cerr << "Invalid frequency '" << line << "' in '" << fname
+                      << "'.\n";
+            exit(1);
+        }
+        query.push_back(f);
+    }
+    const int nfreqs = query.size();
+    
+    InputSequence input(files, params);
+    PointSet points;
+    std::string base;
+    while (input.Next(&points, &base)) {
+        const int npoints = points.size();
+        if (npoints == 0 || nfreqs == 0)
+            continue;
+        const float fnorm = 2.f / sqrtf(npoints);
+        std::vector<Point> freqs(query);
+        for (int i = 0; i < nfreqs; ++i)
+            freqs[i] = Point(query[i].x / fnorm, query[i].y / fnorm);
+        std::vector<float> power(nfreqs);
+        {
+            ProfileScope scope("query");
+            Spectrum::PointSetPower(&freqs[0], nfreqs, &points.points[0],
+                                    npoints, &power[0]);
+        }
+        FILE *fp = fopen((base+"_query.txt").c_str(), "w");
+        if (!fp) {
+            std::cerr << "Cannot create '" << base << "_query.txt'.\n";
+            exit(1);
+        }
+        for (int i = 0; i < nfreqs; ++i)
+            fprintf(fp, "%g %g %g\n", query[i].x, query[i].y,
+                    power[i] / npoints);
+        fclose(fp);
+        Profile::SampleMemory();
+    }
+}
@@ -26,10 +26,22 @@
 #include "param.h"
 #include <vector>
 
+void ExpandContainers(std::vector<std::string> &files);
+void Pack(std::vector<std::string> &files, ParamList &params);
+
 void Analysis(std::vector<std::string> &files,
               ParamList &params, Config &config);
 void AnalysisAverage(std::vector<std::string> &files,
                      ParamList &params, Config &config);
+// Reads the sets in blocks of --chunk points, see PsaContext
+void AnalysisChunked(std::vector<std::string> &files,
+                     ParamList &params, Config &config);
+void ScoreRDF(std::vector<std::string> &files, ParamList &params);
+// Writes the power spectrum in the --window of every set, see SpectrumWindow
+void SpectrumWindows(std::vector<std::string> &files, ParamList &params,
+                     Config &config);
+// Writes the power spectrum at the frequencies listed in the --query file
+void SpectrumQueries(std::vector<std::string> &files, ParamList &params);
 
 #endif  // ANALYSIS_H
 
@@ -0,0 +1,297 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// psa-bench times the engines of psa on synthetic point sets, sweeping over
+// generators, numbers of points, frequency ranges and thread counts. Results
+// are written as one JSON object per line; progress goes to stderr.
+
+#include "generate.h"
+#include "param.h"
+#include "periodogram.h"
+#include "psa.h"
+#include "result.h"
+#include "util.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+static void Usage() {
+    std::cout << "usage: psa-bench [options]\n"
+        "  --help            show this message\n"
+        "  --generators l    comma separated list of uniform, jitter, hexagonal\n"
+        "                    and darts (default all)\n"
+        "  --n l             numbers of points (default 256,1024,4096)\n"
+        "  --frange l        frequency ranges, see common/psa.cfg (default 10)\n"
+        "  --threads l       numbers of threads (default all)\n"
+        "  --repeat n        runs per measurement, the fastest counts (default 3)\n"
+        "  --seed n          seed of the generators (default 1)\n"
+        "  --dir path        directory for temporary files of the I/O and\n"
+        "                    rendering benchmarks (default .)\n"
+        "  --output file     write results to file instead of stdout\n"
+    ;
+}
+
+static double Now()
+{
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+// Shared fields of all records of one configuration
+struct Bench {
+    FILE *out;
+    int repeat;
+    int nthreads;
+    Generator generator;
+    int npoints;
+    float frange;
+    
+    // Runs f repeatedly and records the fastest run. items is the amount of
+    // work per run, e.g. the number of pairs for the RDF.
+    template <class F>
+    void Run(const char *engine, double items, bool hasfrange, F f) {
+        double best = 0, total = 0;
+        for (int i = 0; i < repeat; ++i) {
+            double t = Now();
+            f();
+            t = Now() - t;
+            best = (i == 0) ? t : std::min(best, t);
+            total += t;
+        }
+        fprintf(out, "{\"engine\": \"%s\", \"generator\": \"%s\", "
+                "\"npoints\": %d, ", engine, GeneratorName(generator), npoints);
+        if (hasfrange)
+            fprintf(out, "\"frange\": %g, ", frange);
+        fprintf(out, "\"threads\": %d, \"repeat\": %d, \"seconds\": %.6g, "
+                "\"mean\": %.6g, \"items\": %.6g, \"rate\": %.6g}\n",
+                nthreads, repeat, best, total / repeat, items,
+                best > 0 ? items / best : 0.0);
+        fflush(out);
+    }
+};
+
+// Engines that do not depend on the frequency range
+static void BenchPoints(Bench &b, const PointSet &set, const std::string &dir)
+{
+    const int n = set.size();
+    Config config = DefaultConfig();
+    const float rnorm = 1.f / sqrtf(2.f / (SQRT3 * n));
+    
+    Curve rdf(config.rbinsize * n, 0, config.rrange / rnorm);
+    SpectralAverage spectral(n);
+    Curve fullrdf = spectral.RDFLayout();
+    std::vector<Curve *> rdfs;
+    rdfs.push_back(&rdf);
+    rdfs.push_back(&fullrdf);
+    b.Run("rdf", 0.5 * n * (n - 1), false, [&]() {
+        set.RDF(rdfs);
+    });
+    b.Run("rdf-cells", 0.5 * n * (n - 1), false, [&]() {
+        PointSet::RDFCellList(&set.points[0], n, rdfs);
+    });
+    b.Run("rdftorp", (double) fullrdf.size() * fullrdf.size(), false, [&]() {
+        spectral.Reset();
+        spectral.AddRDF(fullrdf);
+    });
+    spectral.SetHankel(HankelWindowed);
+    b.Run("rdftorp-windowed", (double) fullrdf.size() * fullrdf.size(), false,
+          [&]() {
+        spectral.Reset();
+        spectral.AddRDF(fullrdf);
+    });
+    b.Run("spatial", n, false, [&]() {
+        Statistics stats;
+        SpatialStatistics(set, n, &stats);
+    });
+    
+    const char *formats[] = { ".txt", ".rps", ".qps", ".mps" };
+    for (int i = 0; i < 4; ++i) {
+        std::string fname = dir + "/psa-bench" + formats[i];
+        std::string save = std::string("save") + formats[i];
+        std::string load = std::string("load") + formats[i];
+        PointSet copy(set), loaded;
+        b.Run(save.c_str(), n, false, [&]() { copy.Save(fname); });
+        b.Run(load.c_str(), n, false, [&]() {
+            PointSet::Load(fname, &loaded, NULL);
+        });
+        std::remove(fname.c_str());
+    }
+}
+
+// Engines that depend on the frequency range
+static void BenchSpectrum(Bench &b, const PointSet &set, const std::string &dir)
+{
+    const int n = set.size();
+    const float fnorm = 2.f / sqrtf(n);
+    const int ftsize = b.frange / fnorm;
+    Config config = DefaultConfig();
+    config.frange = b.frange;
+    config.engines = ReferenceEngines();
+    
+    Spectrum s(ftsize * 2);
+    b.Run("ft", (double) n * s.size * s.size, true, [&]() {
+        Spectrum::PointSetSpectrum(&s, set, n);
+    });
+    b.Run("ft-separable", (double) n * s.size * s.size, true, [&]() {
+        Spectrum::PointSetSpectrumSeparable(&s, &set.points[0], n);
+    });
+    Periodogram p;
+    Curve rp(ftsize * config.fbinsize, 0, ftsize), ani(rp.size(), 0, ftsize);
+    b.Run("periodogram", (double) s.size * s.size, true, [&]() {
+        p = Periodogram(s);
+        p.Divide(n);
+        p.RadialPower(&rp);
+        p.Anisotropy(&ani, rp);
+    });
+    
+    // Rendering of everything psa can write for a single set
+    PsaContext context(config);
+    MeasureGraph graph;
+    graph.Request(MeasureRDF);
+    graph.Request(MeasureAnisotropy);
+    graph.Request(MeasureImage);
+    PsaResult pr;
+    context.Analyze(set, graph, &pr);
+    Result r;
+    r.points = set;
+    r.npoints = n;
+    r.nsets = 1;
+    r.stats = pr.stats;
+    r.rp = pr.rp;
+    r.rdf = pr.rdf;
+    r.ani = pr.ani;
+    r.spectrum = pr.spectrum;
+    ParamList params;
+    params.Define("rp", "true");
+    params.Define("rdf", "true");
+    params.Define("ani", "true");
+    params.Define("pspectrum", "true");
+    std::string base = dir + "/psa-bench";
+    b.Run("summary", 1, true, [&]() {
+        SaveSummary(base + ".pdf", r, config);
+    });
+    b.Run("results", 1, true, [&]() {
+        SaveResult(base, r, config, params);
+    });
+    const char *outputs[] = { ".pdf", "_rp.tex", "_rdf.tex", "_ani.tex",
+                              "_spec.png" };
+    for (int i = 0; i < 5; ++i)
+        std::remove((base + outputs[i]).c_str());
+}
+
+int main(int argc, char * const argv[])
+{
+    ParamList params;
+    params.Define("help", "false");
+    params.Define("generators", "uniform,jitter,hexagonal,darts");
+    params.Define("n", "256,1024,4096");
+    params.Define("frange", "10");
+    params.Define("threads", "");
+    params.Define("repeat", "3");
+    params.Define("seed", "1");
+    params.Define("dir", ".");
+    params.Define("output", "");
+    
+    std::vector<std::string> args;
+    params.Parse(argc, argv, args);
+    bool show_usage = params.GetBool("help") || !args.empty();
+    if (const Param *p = params.UnusedOption()) {
+        fprintf(stderr, "Unknown option '%s'.\n", p->name.c_str());
+        show_usage = true;
+    }
+    if (show_usage) {
+        Usage();
+        exit(0);
+    }
+    
+    std::vector<Generator> generators;
+    std::vector<std::string> names = SplitList(params.GetString("generators"));
+    for (unsigned int i = 0; i < names.size(); ++i) {
+        Generator g;
+        if (!ParseGenerator(names[i], &g)) {
+            std::cerr << "Unknown generator '" << names[i] << "'.\n";
+            exit(1);
+        }
+        generators.push_back(g);
+    }
+    std::vector<int> npoints, threads;
+    std::vector<float> franges;
+    names = SplitList(params.GetString("n"));
+    for (unsigned int i = 0; i < names.size(); ++i)
+        npoints.push_back(std::max(2, atoi(names[i].c_str())));
+    names = SplitList(params.GetString("frange"));
+    for (unsigned int i = 0; i < names.size(); ++i)
+        franges.push_back(std::max(atof(names[i].c_str()), 1.0));
+    names = SplitList(params.GetString("threads"));
+    for (unsigned int i = 0; i < names.size(); ++i)
+        threads.push_back(std::max(1, atoi(names[i].c_str())));
+#ifdef _OPENMP
+    if (threads.empty())
+        threads.push_back(omp_get_max_threads());
+#else
+    threads.assign(1, 1);
+#endif
+    
+    Bench b;
+    b.out = stdout;
+    b.repeat = std::max(1, params.GetInt("repeat"));
+    std::string output = params.GetString("output");
+    if (!output.empty() && !(b.out = fopen(output.c_str(), "w"))) {
+        std::cerr << "Cannot create '" << output << "'.\n";
+        exit(1);
+    }
+    std::string dir = params.GetString("dir");
+    unsigned int seed = params.GetInt("seed");
+    
+    const int nruns = threads.size() * generators.size() * npoints.size();
+    int run = 0;
+    for (unsigned int t = 0; t < threads.size(); ++t) {
+        b.nthreads = threads[t];
+#ifdef _OPENMP
+        omp_set_num_threads(b.nthreads);
+#endif
+        for (unsigned int g = 0; g < generators.size(); ++g) {
+            for (unsigned int i = 0; i < npoints.size(); ++i) {
+                std::cerr << "[" << ++run << "/" << nruns << "] "
+                          << GeneratorName(generators[g]) << ", "
+                          << npoints[i] << " points, "
+                          << b.nthreads << " threads\n";
+                PointSet set;
+                GeneratePoints(generators[g], npoints[i], seed, &set);
+                b.generator = generators[g];
+                b.npoints = npoints[i];
+                BenchPoints(b, set, dir);
+                for (unsigned int f = 0; f < franges.size(); ++f) {
+                    b.frange = franges[f];
+                    BenchSpectrum(b, set, dir);
+                }
+            }
+        }
+    }
+    if (b.out != stdout)
+        fclose(b.out);
+}
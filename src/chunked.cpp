@@ -0,0 +1,144 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "chunked.h"
+#include "profile.h"
+#include <algorithm>
+#include <cmath>
+
+
+bool ChunkedSpectrum(PointBlockReader &reader, int chunk, Spectrum *spectrum)
+{
+    // Blocks of whole groups of the separable kernel sum in the same order
+    // as the spectrum of all points at once
+    const int group = SpectrumAccumulator::GroupSize;
+    chunk = (chunk >= group) ? chunk - chunk % group : chunk;
+    const long npoints = reader.NumPoints();
+    SpectrumAccumulator acc(spectrum->size);
+    std::vector<Point> block(std::min((long) chunk, npoints));
+    for (long first = 0; first < npoints; first += chunk) {
+        const int n = std::min((long) chunk, npoints - first);
+        {
+            ProfileScope scope("read block");
+            if (!reader.Read(first, n, &block[0]))
+                return false;
+        }
+        acc.Add(&block[0], n);
+    }
+    acc.Get(spectrum);
+    return true;
+}
+
+static inline int Strip(float y, int nstrips)
+{
+    return std::max(0, std::min(nstrips - 1, (int) (y * nstrips)));
+}
+
+// Distance on the torus from y to the strip s
+static inline float StripDistance(float y, int s, int nstrips)
+{
+    const float lo = (float) s / nstrips, hi = (float) (s + 1) / nstrips;
+    float up = y - hi, down = lo - y;
+    up -= floorf(up);
+    down -= floorf(down);
+    return std::min(up, down);
+}
+
+// Gathers the points of strip s into strip, if not NULL, and those of strip
+// t that are closer than range to strip s into halo, in a pass over the
+// blocks
+static bool GatherStrips(PointBlockReader &reader, int chunk,
+                         std::vector<Point> &block, int nstrips, int s, int t,
+                         float range, std::vector<Point> *strip,
+                         std::vector<Point> *halo)
+{
+    const long npoints = reader.NumPoints();
+    if (strip) strip->clear();
+    if (halo) halo->clear();
+    for (long first = 0; first < npoints; first += chunk) {
+        const int n = std::min((long) chunk, npoints - first);
+        {
+            ProfileScope scope("read block");
+            if (!reader.Read(first, n, &block[0]))
+                return false;
+        }
+        for (int i = 0; i < n; ++i) {
+            const int u = Strip(block[i].y, nstrips);
+            if (strip && u == s)
+                strip->push_back(block[i]);
+            else if (halo && u == t &&
+                     StripDistance(block[i].y, s, nstrips) < range)
+                halo->push_back(block[i]);
+        }
+    }
+    return true;
+}
+
+bool ChunkedRDF(PointBlockReader &reader, int chunk,
+                const std::vector<Curve *> &rdfs)
+{
+    const long npoints = reader.NumPoints();
+    Profile::Count(CounterPairs, 0.5 * npoints * (npoints - 1.0));
+    const int ncurves = rdfs.size();
+    float range = 0.f;
+    for (int k = 0; k < ncurves; ++k)
+        range = std::max(range, rdfs[k]->x0 + rdfs[k]->size() * rdfs[k]->dx);
+    std::vector<std::vector<unsigned long> > bins(ncurves);
+    for (int k = 0; k < ncurves; ++k)
+        bins[k].assign(rdfs[k]->size(), 0);
+    
+    // Strips of about chunk points, whatever the range. The pairs of two
+    // strips are binned from the one that the other lies at most half way
+    // around the torus above, or from the lower one when it is exactly half
+    // way, so that every pair is binned once. Strips beyond the range are
+    // skipped.
+    const int nstrips = (int) std::min((npoints + chunk - 1) / chunk, 1L << 20);
+    const int reach = std::min((int) ceilf(range * nstrips), nstrips / 2);
+    
+    std::vector<Point> block(std::min((long) chunk, npoints));
+    std::vector<Point> strip, halo;
+    for (int s = 0; s < nstrips; ++s) {
+        std::vector<int> above;
+        for (int o = 1; o <= reach; ++o) {
+            const int t = (s + o) % nstrips;
+            if (2 * o < nstrips || s < t)
+                above.push_back(t);
+        }
+        // The strip is gathered along with the first strip above it
+        for (size_t h = 0; h == 0 || h < above.size(); ++h) {
+            const bool first = (h == 0);
+            const int t = (h < above.size()) ? above[h] : -1;
+            if (!GatherStrips(reader, chunk, block, nstrips, s, t, range,
+                              first ? &strip : NULL, t >= 0 ? &halo : NULL))
+                return false;
+            if (strip.empty())
+                break;
+            if (first)
+                PointSet::BinPairs(&strip[0], strip.size(), strip.size(),
+                                   rdfs, bins);
+            if (t >= 0 && !halo.empty())
+                PointSet::BinCrossPairs(&strip[0], strip.size(), &halo[0],
+                                        halo.size(), rdfs, bins);
+        }
+    }
+    NormalizeRDF(npoints, bins, rdfs);
+    return true;
+}
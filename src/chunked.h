@@ -0,0 +1,52 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHUNKED_H
+#define CHUNKED_H
+
+#include "curve.h"
+#include "point.h"
+#include "spectrum.h"
+#include <vector>
+
+// Measures of point sets that are too large to be held in memory, computed
+// from blocks of at most chunk points that are read one after another. The
+// memory is bounded by the chunk size plus the output grids. Both return
+// false if a block cannot be read.
+
+// Spectrum of the size of spectrum, summed block by block. Blocks are
+// rounded down to whole groups of SpectrumAccumulator, which gives the same
+// sums as Spectrum::PointSetSpectrumSeparable() of all points.
+bool ChunkedSpectrum(PointBlockReader &reader, int chunk, Spectrum *spectrum);
+
+// Same RDFs as PointSet::RDFCellList(). The torus is cut into horizontal
+// strips of about chunk points, whatever the curve range. Each strip is
+// gathered in a pass over all blocks and its own pairs are binned. Then the
+// points within range of it are gathered from each of the strips up to the
+// range above it, one strip per pass, wrapping around the torus, and the
+// pairs across are binned. Each pair of strips is visited from one side
+// only. A range of half the torus, as for the spectral statistics, takes
+// about nstrips^2 / 2 passes and O(N^2) time, but still only the memory of
+// two strips.
+bool ChunkedRDF(PointBlockReader &reader, int chunk,
+                const std::vector<Curve *> &rdfs);
+
+#endif  // CHUNKED_H
@@ -0,0 +1,321 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "compress.h"
+#include "util.h"
+#include <algorithm>
+#include <climits>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+static const uint8_t QPSMagic[4] = { 'P', 'S', 'A', 'Q' };
+static const uint32_t QPSVersion = 1;
+static const int QPSBlockSize = 4096;
+// Largest block size accepted from a file
+static const uint32_t QPSMaxBlockSize = 1u << 20;
+// Every block starts with its first code and Rice parameter
+static const int QPSBlockHeaderSize = 9;
+static const int QPSHeaderSize = 24;
+static const int QPSMaxRice = 48;
+// Deltas whose unary part would reach this length are stored verbatim
+static const int QPSEscape = 40;
+
+
+static inline void Put32(std::vector<uint8_t> &buf, uint32_t v) {
+    for (int i = 0; i < 4; ++i)
+        buf.push_back((uint8_t) (v >> (8*i)));
+}
+
+static inline void Put64(std::vector<uint8_t> &buf, uint64_t v) {
+    for (int i = 0; i < 8; ++i)
+        buf.push_back((uint8_t) (v >> (8*i)));
+}
+
+static inline uint32_t Get32(const uint8_t *p) {
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; --i)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+static inline uint64_t Get64(const uint8_t *p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; --i)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+static inline uint64_t Part1By1(uint32_t v) {
+    uint64_t x = v;
+    x = (x | (x << 16)) & 0x0000ffff0000ffffULL;
+    x = (x | (x <<  8)) & 0x00ff00ff00ff00ffULL;
+    x = (x | (x <<  4)) & 0x0f0f0f0f0f0f0f0fULL;
+    x = (x | (x <<  2)) & 0x3333333333333333ULL;
+    x = (x | (x <<  1)) & 0x5555555555555555ULL;
+    return x;
+}
+
+static inline uint32_t Compact1By1(uint64_t x) {
+    x &= 0x5555555555555555ULL;
+    x = (x | (x >>  1)) & 0x3333333333333333ULL;
+    x = (x | (x >>  2)) & 0x0f0f0f0f0f0f0f0fULL;
+    x = (x | (x >>  4)) & 0x00ff00ff00ff00ffULL;
+    x = (x | (x >>  8)) & 0x0000ffff0000ffffULL;
+    x = (x | (x >> 16)) & 0x00000000ffffffffULL;
+    return (uint32_t) x;
+}
+
+// Coordinates in [0, 1]; 1 falls into the last cell, which is within the
+// quantization error
+static inline uint32_t Quantize(float f, int bits) {
+    const double cells = ldexp(1.0, bits);
+    return (uint32_t) std::min(floor(f * cells), cells - 1.0);
+}
+
+
+// LSB-first bit packing. Values of up to 56 bits are written at once.
+class BitWriter {
+    std::vector<uint8_t> &buf;
+    uint64_t acc;
+    int nbits;
+public:
+    BitWriter(std::vector<uint8_t> &buf) : buf(buf), acc(0), nbits(0) {}
+    inline void Put(uint64_t v, int n) {
+        acc |= v << nbits;
+        nbits += n;
+        while (nbits >= 8) {
+            buf.push_back((uint8_t) acc);
+            acc >>= 8;
+            nbits -= 8;
+        }
+    }
+    void Flush() {
+        if (nbits > 0)
+            buf.push_back((uint8_t) acc);
+        acc = 0;
+        nbits = 0;
+    }
+};
+
+// Reads from a buffer that is followed by at least eight readable bytes, so
+// that every peek can load a full word without a bounds check
+class BitReader {
+    const uint8_t *data;
+    uint64_t pos;
+public:
+    BitReader(const uint8_t *data) : data(data), pos(0) {}
+    inline uint64_t Peek() const {
+        uint64_t w;
+        memcpy(&w, data + (pos >> 3), 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        w = __builtin_bswap64(w);
+#endif
+        return w >> (pos & 7);
+    }
+    inline uint64_t Get(int n) {
+        uint64_t v = (n == 0) ? 0 : Peek() & (~0ULL >> (64 - n));
+        pos += n;
+        return v;
+    }
+    inline void Skip(int n) { pos += n; }
+    inline uint64_t Position() const { return pos; }
+};
+
+static inline int CountTrailingZeros(uint64_t w) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(w);
+#else
+    int n = 0;
+    while (!(w & 1)) { w >>= 1; ++n; }
+    return n;
+#endif
+}
+
+static void EncodeBlock(const uint64_t *codes, int n, int bits,
+                        std::vector<uint8_t> &buf)
+{
+    Put64(buf, codes[0]);
+    
+    // Rice parameter close to the optimum for geometrically distributed
+    // deltas, as produced by sorted Morton codes of well-spread points
+    double mean = (n > 1) ? (codes[n-1] - codes[0]) / (double) (n - 1) : 0;
+    int k = (mean >= 2.0) ? (int) floor(log2(mean * 0.69)) : 0;
+    k = std::min(std::max(k, 0), QPSMaxRice);
+    buf.push_back((uint8_t) k);
+    
+    BitWriter writer(buf);
+    for (int i = 1; i < n; ++i) {
+        uint64_t d = codes[i] - codes[i-1];
+        uint64_t q = d >> k;
+        if (q < (uint64_t) QPSEscape) {
+            writer.Put(1ULL << q, q + 1);
+            writer.Put(d & ((1ULL << k) - 1), k);
+        } else {
+            writer.Put(1ULL << QPSEscape, QPSEscape + 1);
+            writer.Put(d & ((1ULL << bits) - 1), bits);
+            writer.Put(d >> bits, bits);
+        }
+    }
+    writer.Flush();
+}
+
+static bool DecodeBlock(const uint8_t *data, uint64_t size, int n, int bits,
+                        Point *points)
+{
+    if (size < QPSBlockHeaderSize)
+        return false;
+    uint64_t code = Get64(data);
+    const int k = data[8];
+    if (k > QPSMaxRice)
+        return false;
+    
+    const uint64_t maxcode = (1ULL << (2*bits)) - 1;
+    const uint64_t limit = 8 * (size - QPSBlockHeaderSize);
+    const double scale = ldexp(1.0, -bits);
+    BitReader reader(data + QPSBlockHeaderSize);
+    for (int i = 0; i < n; ++i) {
+        if (i > 0) {
+            uint64_t w = reader.Peek();
+            if (w == 0)
+                return false;
+            int q = CountTrailingZeros(w);
+            reader.Skip(q + 1);
+            uint64_t d;
+            if (q < QPSEscape)
+                d = ((uint64_t) q << k) | reader.Get(k);
+            else if (q == QPSEscape) {
+                d = reader.Get(bits);
+                d |= reader.Get(bits) << bits;
+            } else
+                return false;
+            if (reader.Position() > limit)
+                return false;
+            code += d;
+        }
+        if (code > maxcode)
+            return false;
+        points[i].x = (float) ((Compact1By1(code     ) + 0.5) * scale);
+        points[i].y = (float) ((Compact1By1(code >> 1) + 0.5) * scale);
+    }
+    return true;
+}
+
+
+bool EncodeQPS(const PointSet &set, int bits, std::vector<uint8_t> *data)
+{
+    if (bits < QPSMinBits || bits > QPSMaxBits)
+        return false;
+    const int npoints = set.size();
+    for (int i = 0; i < npoints; ++i)
+        if (!(set[i].x >= 0.f && set[i].x <= 1.f &&
+              set[i].y >= 0.f && set[i].y <= 1.f))
+            return false;
+    std::vector<uint64_t> codes(npoints);
+    for (int i = 0; i < npoints; ++i)
+        codes[i] = Part1By1(Quantize(set[i].x, bits)) |
+                   Part1By1(Quantize(set[i].y, bits)) << 1;
+    std::sort(codes.begin(), codes.end());
+    
+    const int nblocks = (npoints + QPSBlockSize - 1) / QPSBlockSize;
+    std::vector<std::vector<uint8_t> > blocks(nblocks);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int b = 0; b < nblocks; ++b) {
+        int first = b * QPSBlockSize;
+        int n = std::min(QPSBlockSize, npoints - first);
+        EncodeBlock(&codes[first], n, bits, blocks[b]);
+    }
+    
+    data->clear();
+    for (int i = 0; i < 4; ++i)
+        data->push_back(QPSMagic[i]);
+    Put32(*data, QPSVersion);
+    Put32(*data, bits);
+    Put32(*data, npoints);
+    Put32(*data, QPSBlockSize);
+    Put32(*data, nblocks);
+    uint64_t offset = 0;
+    for (int b = 0; b < nblocks; ++b) {
+        Put64(*data, offset);
+        offset += blocks[b].size();
+    }
+    Put64(*data, offset);
+    for (int b = 0; b < nblocks; ++b)
+        data->insert(data->end(), blocks[b].begin(), blocks[b].end());
+    return true;
+}
+
+bool DecodeQPS(const uint8_t *data, size_t size, PointSet *set)
+{
+    if (size < QPSHeaderSize || memcmp(data, QPSMagic, 4) != 0 ||
+        Get32(data + 4) != QPSVersion)
+        return false;
+    const int bits = Get32(data + 8);
+    const uint32_t npoints = Get32(data + 12);
+    const uint32_t blocksize = Get32(data + 16);
+    const uint32_t nblocks = Get32(data + 20);
+    if (bits < QPSMinBits || bits > QPSMaxBits || blocksize == 0 ||
+        blocksize > QPSMaxBlockSize || npoints > (uint32_t) INT_MAX ||
+        nblocks != (npoints + (uint64_t) blocksize - 1) / blocksize ||
+        size < QPSHeaderSize + 8 * ((uint64_t) nblocks + 1))
+        return false;
+    
+    const uint8_t *index = data + QPSHeaderSize;
+    const uint8_t *blockdata = index + 8 * (nblocks + 1);
+    const uint64_t datasize = size - (blockdata - data);
+    if (Get64(index + 8 * nblocks) > datasize)
+        return false;
+    // Every point but the first of a block takes at least one bit, so a
+    // header cannot claim more points than the data holds
+    const uint64_t minbits = npoints - (uint64_t) nblocks;
+    if ((uint64_t) nblocks * QPSBlockHeaderSize + (minbits + 7) / 8 > datasize)
+        return false;
+    
+    // The bit reader loads whole words, so a block that is not followed by
+    // at least eight more bytes is decoded from a padded copy
+    set->points.resize(npoints);
+    bool ok = true;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) reduction(&&:ok)
+#endif
+    for (int b = 0; b < (int) nblocks; ++b) {
+        uint64_t begin = Get64(index + 8 * b);
+        uint64_t end = Get64(index + 8 * (b + 1));
+        if (begin > end || end > datasize) {
+            ok = false;
+            continue;
+        }
+        const uint8_t *p = blockdata + begin;
+        std::vector<uint8_t> padded;
+        if (end + 8 > datasize) {
+            padded.resize(end - begin + 8, 0);
+            memcpy(&padded[0], p, end - begin);
+            p = &padded[0];
+        }
+        int first = b * blocksize;
+        int n = std::min(blocksize, npoints - first);
+        ok = DecodeBlock(p, end - begin, n, bits, &set->points[first]) && ok;
+    }
+    return ok;
+}
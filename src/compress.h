@@ -0,0 +1,59 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include "point.h"
+#include <stdint.h>
+#include <vector>
+
+// Compact QPS storage for point sets in the unit torus. Coordinates are
+// quantized to 'bits' bits of fixed point, with a maximum error of
+// 2^-(bits+1) per coordinate (7.6e-6 for 16 and 3.0e-8 for 24 bits) plus at
+// most 3.0e-8 of float rounding. The quantized points are interleaved into
+// Morton codes and sorted, and the code deltas are Rice coded in blocks
+// that can be decoded in parallel. Decoding does not preserve point order.
+// The layout is (all little endian)
+//
+//   char    magic[4]            "PSAQ"
+//   uint32  version             1
+//   uint32  bits                8..31
+//   uint32  npoints
+//   uint32  blocksize           points per block
+//   uint32  nblocks
+//   uint64  offsets[nblocks+1]  block offsets relative to the first block
+//   ...                         per block: uint64 first code, uint8 Rice
+//                               parameter, bitstream of the remaining deltas
+static const int QPSMinBits = 8;
+static const int QPSMaxBits = 31;
+
+// Fails for bits out of range and for coordinates outside [0, 1]
+bool EncodeQPS(const PointSet &set, int bits, std::vector<uint8_t> *data);
+// Fails for data that is truncated, corrupt, or claims more points or larger
+// blocks than it can hold
+bool DecodeQPS(const uint8_t *data, size_t size, PointSet *set);
+
+inline float QPSMaxError(int bits) {
+    return ldexpf(1.f, -(bits + 1));
+}
+
+#endif  // COMPRESS_H
@@ -20,13 +20,12 @@
  */
 
 #include "config.h"
-#include <cassert>
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 
-Config LoadConfig(const std::string &fname) {
-    // Default config
+Config DefaultConfig() {
     Config config;
     config.frange   = 10;
     config.fbinsize =  0.5;
@@ -36,17 +35,50 @@ Config LoadConfig(const std::string &fname) {
     config.fymax    =  4.2;
     config.rymin    = -0.2;
     config.rymax    =  4.2;
+    config.pointraster = 100000;
+    config.ftmemory = 0;
+    config.ftdownsample = 1;
+    config.rpangles = 0;
+    config.rdfanchors = 0;
+    config.rdftime = 0;
+    config.rdfprecision = 0;
+    config.engines = AutoEngines();
+    return config;
+}
+
+Config LoadConfig(const std::string &fname) {
+    if (!std::ifstream(fname.c_str())) {
+        std::cout << "Config file '" << fname << "' not found. "
+                  << "Using defaults.\n";
+        return DefaultConfig();
+    }
+    Config config;
+    std::string error;
+    if (!LoadConfig(fname, &config, &error)) {
+        std::cerr << error << "\n";
+        exit(1);
+    }
+    return config;
+}
+
+bool LoadConfig(const std::string &fname, Config *result, std::string *error)
+{
+    Config config = DefaultConfig();
     
     std::ifstream file(fname.c_str());
     if (!file) {
-        std::cout << "Config file '" << fname << "' not found. "
-                  << "Using defaults.\n";
-        return config;
+        *error = "Cannot read config file '" + fname + "'.";
+        return false;
     }
     
-    while (!file.eof()) {
-        std::string line, key, val;
-        getline(file, line);
+    // Choices of the autotuner are kept next to the config file
+    size_t sep = fname.find_last_of("/\\");
+    config.tunecache = (sep == std::string::npos ? "" : fname.substr(0, sep + 1))
+                       + "psa.tune";
+    
+    std::string line;
+    while (getline(file, line)) {
+        std::string key, val;
         
         std::istringstream issline(line);
         issline >> std::ws >> key;
@@ -75,10 +107,44 @@ Config LoadConfig(const std::string &fname) {
         } else if (key == "rymax") {
             issline >> std::ws >> val;
             config.rymax = atof(val.c_str());
+        } else if (key == "pointraster") {
+            issline >> std::ws >> val;
+            config.pointraster = std::max(atoi(val.c_str()), 0);
+        } else if (key == "ftmemory") {
+            issline >> std::ws >> val;
+            config.ftmemory = std::max(atof(val.c_str()), 0.0);
+        } else if (key == "ftdownsample") {
+            issline >> std::ws >> val;
+            config.ftdownsample = std::max(atoi(val.c_str()), 1);
+        } else if (key == "rpangles") {
+            issline >> std::ws >> val;
+            config.rpangles = std::max(atoi(val.c_str()), 0);
+        } else if (key == "rdfanchors") {
+            issline >> std::ws >> val;
+            config.rdfanchors = std::max(atoi(val.c_str()), 0);
+        } else if (key == "rdftime") {
+            issline >> std::ws >> val;
+            config.rdftime = std::max(atof(val.c_str()), 0.0);
+        } else if (key == "rdfprecision") {
+            issline >> std::ws >> val;
+            config.rdfprecision = std::max(atof(val.c_str()), 0.0);
+        } else if (key == "engines") {
+            issline >> std::ws >> val;
+            if (!ParseEngines(val, &config.engines)) {
+                *error = "Invalid engines '" + val + "' in '" + fname + "'.";
+                return false;
+            }
         }
     }
-    assert(config.fymin < config.fymax);
-    assert(config.rymin < config.rymax);
+    if (file.bad()) {
+        *error = "Cannot read config file '" + fname + "'.";
+        return false;
+    }
+    if (!(config.fymin < config.fymax) || !(config.rymin < config.rymax)) {
+        *error = "Empty plot range in '" + fname + "'.";
+        return false;
+    }
     
-    return config;
+    *result = config;
+    return true;
 }
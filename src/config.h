@@ -22,6 +22,7 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#include "engine.h"
 #include <stdlib.h>
 #include <string>
 
@@ -35,9 +36,28 @@ struct Config {
     float fymax;     // Maximum y-value for RP/Ani plot output
     float rymin;     // Minimum y-value for RDF plot output
     float rymax;     // Minimum y-value for RDF plot output
+    int pointraster; // Point count from which summaries rasterize the points
+    float ftmemory;  // MB for the spectrum, larger grids are banded (0: no limit)
+    int ftdownsample; // Downsampling of spectrum images of banded grids
+    int rpangles;    // Frequencies sampled per RP/Ani ring (0: full grid)
+    int rdfanchors;  // Anchor points of a sampled RDF (0: no limit)
+    float rdftime;   // Seconds for a sampled RDF (0: no limit)
+    float rdfprecision; // Target standard error of a sampled RDF (0: none)
+    Engines engines; // Engines of the costly stages, see engine.h
+    std::string tunecache; // File of the autotuner's choices, see tune.h
+    
+    // Any of the RDF limits samples the RDFs, see rdfsample.h
+    bool SampledRDF() const {
+        return rdfanchors > 0 || rdftime > 0.f || rdfprecision > 0.f;
+    }
 };
 
+Config DefaultConfig();
+// LoadConfig() without an error argument falls back to the defaults if the
+// file does not exist, and reports other errors and exits; the other variant
+// returns false and describes any error instead, a missing file included
 Config LoadConfig(const std::string &fname);
+bool LoadConfig(const std::string &fname, Config *config, std::string *error);
 
 #endif  // UTIL_H
 
@@ -104,10 +104,14 @@ Curve Curve::Load(const std::string &fname) {
     return c;
 }
 
-void Curve::SaveTXT(const std::string &fname) {
+void Curve::SaveTXT(const std::string &fname, const Curve *errors) {
     std::ofstream os(fname.c_str());
-    for (int i = 0; i < size(); ++i)
-        os << ToX(i) << " " << y[i] << "\n";
+    for (int i = 0; i < size(); ++i) {
+        os << ToX(i) << " " << y[i];
+        if (errors && i < errors->size())
+            os << " " << (*errors)[i];
+        os << "\n";
+    }
 }
 
 void Curve::SaveTEX(const std::string &fname, std::string labels[2],
@@ -49,7 +49,8 @@ public:
     void SetZero();
     
     static Curve Load(const std::string &fname);
-    void SaveTXT(const std::string &fname);
+    // Standard errors, e.g. of a sampled RDF, go into a third column
+    void SaveTXT(const std::string &fname, const Curve *errors = NULL);
     void SaveTEX(const std::string &fname, std::string labels[2],
                  float yrange[2], float refLvl, float xscale);
 };
@@ -0,0 +1,107 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "engine.h"
+#include "util.h"
+
+static const int NumStages = 3;
+static const char *StageNames[NumStages] = { "ft", "rdf", "hankel" };
+static const int NumEngines[NumStages] = {
+    NumFTEngines, NumRDFEngines, NumHankelEngines
+};
+static const char *EngineNames[NumStages][2] = {
+    { "direct", "separable" },
+    { "pairs", "cells" },
+    { "direct", "windowed" }
+};
+
+static int *Stage(Engines *engines, int stage)
+{
+    switch (stage) {
+        case 0:  return &engines->ft;
+        case 1:  return &engines->rdf;
+        default: return &engines->hankel;
+    }
+}
+
+Engines ReferenceEngines()
+{
+    Engines engines;
+    engines.ft = FTDirect;
+    engines.rdf = RDFPairs;
+    engines.hankel = HankelDirect;
+    return engines;
+}
+
+Engines AutoEngines()
+{
+    Engines engines;
+    engines.ft = engines.rdf = engines.hankel = EngineAuto;
+    return engines;
+}
+
+bool ParseEngines(const std::string &spec, Engines *engines)
+{
+    if (spec == "auto") {
+        *engines = AutoEngines();
+        return true;
+    }
+    if (spec == "reference") {
+        *engines = ReferenceEngines();
+        return true;
+    }
+    Engines parsed = *engines;
+    std::vector<std::string> items = SplitList(spec);
+    if (items.empty())
+        return false;
+    for (unsigned int i = 0; i < items.size(); ++i) {
+        size_t eq = items[i].find('=');
+        if (eq == std::string::npos)
+            return false;
+        std::string stage = items[i].substr(0, eq);
+        std::string name = items[i].substr(eq + 1);
+        int s = 0;
+        while (s < NumStages && stage != StageNames[s])
+            ++s;
+        if (s == NumStages)
+            return false;
+        int e = (name == "auto") ? EngineAuto : 0;
+        while (e != EngineAuto && e < NumEngines[s] && name != EngineNames[s][e])
+            ++e;
+        if (e == NumEngines[s])
+            return false;
+        *Stage(&parsed, s) = e;
+    }
+    *engines = parsed;
+    return true;
+}
+
+std::string EnginesString(const Engines &engines)
+{
+    Engines copy = engines;
+    std::string s;
+    for (int i = 0; i < NumStages; ++i) {
+        int e = *Stage(&copy, i);
+        s += std::string(i > 0 ? "," : "") + StageNames[i] + "=" +
+             (e == EngineAuto ? "auto" : EngineNames[i][e]);
+    }
+    return s;
+}
@@ -0,0 +1,50 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <string>
+
+// Implementations of the costly stages, which give the same results within
+// the tolerances checked by psa-validate but differ in speed
+enum FTEngine     { FTDirect, FTSeparable, NumFTEngines };
+enum RDFEngine    { RDFPairs, RDFCells, NumRDFEngines };
+enum HankelEngine { HankelDirect, HankelWindowed, NumHankelEngines };
+
+// Leaves the choice of an engine to the autotuner
+const int EngineAuto = -1;
+
+struct Engines {
+    int ft;      // FTEngine or EngineAuto
+    int rdf;     // RDFEngine or EngineAuto
+    int hankel;  // HankelEngine or EngineAuto
+};
+
+Engines ReferenceEngines();
+Engines AutoEngines();
+
+// Parses 'auto', 'reference' or comma separated stage=engine pairs such as
+// 'ft=separable,rdf=auto'; stages that are not listed keep their engine
+bool ParseEngines(const std::string &spec, Engines *engines);
+std::string EnginesString(const Engines &engines);
+
+#endif  // ENGINE_H
@@ -0,0 +1,140 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "generate.h"
+#include "util.h"
+#include <random>
+
+
+static const char *GeneratorNames[NumGenerators] = {
+    "uniform", "jitter", "hexagonal", "darts"
+};
+
+const char *GeneratorName(Generator g)
+{
+    return GeneratorNames[g];
+}
+
+bool ParseGenerator(const std::string &name, Generator *g)
+{
+    for (int i = 0; i < NumGenerators; ++i) {
+        if (name == GeneratorNames[i]) {
+            *g = static_cast<Generator>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void Uniform(int npoints, std::mt19937 &rng, PointSet *set)
+{
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    for (int i = 0; i < npoints; ++i) {
+        Point p(u(rng), u(rng));
+        p.WrapUnitTorus();
+        set->points.push_back(p);
+    }
+}
+
+static void Jitter(int npoints, std::mt19937 &rng, PointSet *set)
+{
+    const int m = (int) ceilf(sqrtf(npoints));
+    std::vector<int> cells(m * m);
+    for (int i = 0; i < m * m; ++i)
+        cells[i] = i;
+    std::shuffle(cells.begin(), cells.end(), rng);
+    
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    for (int i = 0; i < npoints; ++i) {
+        Point p((cells[i] % m + u(rng)) / m, (cells[i] / m + u(rng)) / m);
+        p.WrapUnitTorus();
+        set->points.push_back(p);
+    }
+}
+
+static void Hexagonal(int npoints, std::mt19937 &rng, PointSet *set)
+{
+    // Rows of spacing a, shifted by half a spacing every other row, and
+    // offsets of up to a tenth of the spacing
+    const float a = sqrtf(2.f / (SQRT3 * npoints));
+    const int nrows = std::max(1, (int) roundf(2.f / (SQRT3 * a)));
+    const int ncols = (npoints + nrows - 1) / nrows;
+    std::uniform_real_distribution<float> u(-0.1f * a, 0.1f * a);
+    for (int i = 0; i < npoints; ++i) {
+        int row = i / ncols, col = i % ncols;
+        Point p((col + 0.5f * (row & 1)) / ncols + u(rng),
+                (row + 0.5f) / nrows + u(rng));
+        p.x -= floorf(p.x);
+        p.y -= floorf(p.y);
+        p.WrapUnitTorus();
+        set->points.push_back(p);
+    }
+}
+
+static void Darts(int npoints, std::mt19937 &rng, PointSet *set)
+{
+    // Minimum distance relative to the hexagonal lattice, low enough for
+    // the darts to reach n points; a background grid with cells no larger
+    // than the radius limits the tests to the 3x3 neighboring cells
+    const float r = 0.65f * sqrtf(2.f / (SQRT3 * npoints));
+    const float r2 = r * r;
+    const int m = std::max(1, (int) (1.f / r));
+    std::vector<std::vector<int> > grid(m * m);
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    
+    const long maxtrials = 1000L * npoints;
+    for (long trial = 0; trial < maxtrials && set->size() < npoints; ++trial) {
+        Point p(u(rng), u(rng));
+        p.WrapUnitTorus();
+        int cx = std::min((int) (p.x * m), m - 1);
+        int cy = std::min((int) (p.y * m), m - 1);
+        bool ok = true;
+        for (int dy = -1; ok && dy <= 1; ++dy) {
+            for (int dx = -1; ok && dx <= 1; ++dx) {
+                const std::vector<int> &cell =
+                    grid[(cx + dx + m) % m + ((cy + dy + m) % m) * m];
+                for (unsigned int k = 0; ok && k < cell.size(); ++k)
+                    ok = p.SquaredDistUnitTorus(set->points[cell[k]]) >= r2;
+            }
+        }
+        if (ok) {
+            grid[cx + cy * m].push_back(set->size());
+            set->points.push_back(p);
+        }
+    }
+    
+    // Should the darts ever saturate, the set is completed with random points
+    Uniform(npoints - set->size(), rng, set);
+}
+
+void GeneratePoints(Generator g, int npoints, unsigned int seed, PointSet *set)
+{
+    std::mt19937 rng(seed);
+    set->points.clear();
+    set->points.reserve(npoints);
+    switch (g) {
+        case GenerateUniform:   Uniform(npoints, rng, set); break;
+        case GenerateJitter:    Jitter(npoints, rng, set); break;
+        case GenerateHexagonal: Hexagonal(npoints, rng, set); break;
+        case GenerateDarts:     Darts(npoints, rng, set); break;
+        default: break;
+    }
+}
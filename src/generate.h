@@ -0,0 +1,42 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GENERATE_H
+#define GENERATE_H
+
+#include "point.h"
+#include <string>
+
+// Synthetic point sets in the unit torus for benchmarks and tests. The same
+// seed always yields the same set.
+enum Generator {
+    GenerateUniform,     // uniform random points
+    GenerateJitter,      // one random point in each of n random grid cells
+    GenerateHexagonal,   // hexagonal lattice with small random offsets
+    GenerateDarts,       // dart throwing with a minimum distance
+    NumGenerators
+};
+
+const char *GeneratorName(Generator g);
+bool ParseGenerator(const std::string &name, Generator *g);
+void GeneratePoints(Generator g, int npoints, unsigned int seed, PointSet *set);
+
+#endif  // GENERATE_H
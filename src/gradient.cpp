@@ -0,0 +1,403 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gradient.h"
+#include "periodogram.h"
+#include "profile.h"
+#include "spectrum.h"
+#include "util.h"
+
+
+// Gradient of a loss given its derivative dldp by the periodogram at every
+// frequency w. With F the spectrum and e_j the phasor of point j,
+//
+//   dP(w)/dx_j = 4 pi / N * w_x * Im(conj(F(w)) e_j(w))
+//
+// and likewise for y. The phasors factor into x and y parts, so the sums over
+// w are taken over x for a chunk of points at once, with the points in the
+// inner loop, and then over y.
+static void PeriodogramGradient(const Point *points, int npoints,
+                                const Spectrum &s,
+                                const std::vector<float> &dldp,
+                                float *gradient)
+{
+    ProfileScope scope("gradient");
+    const int size = s.size, size2 = size / 2;
+    const int chunk = 64;
+    std::vector<float> hr(size * size), hi(size * size);
+    for (int i = 0; i < size * size; ++i) {
+        hr[i] =  dldp[i] * s.ft[2*i];
+        hi[i] = -dldp[i] * s.ft[2*i+1];
+    }
+    const float scale = 2.f * TWOPI / npoints;
+    const int nchunks = (npoints + chunk - 1) / chunk;
+    
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int c = 0; c < nchunks; ++c) {
+        const int first = c * chunk, n = std::min(chunk, npoints - first);
+        std::vector<float> xr(size * chunk), xi(size * chunk);
+        std::vector<float> yr(size * chunk), yi(size * chunk);
+        for (int w = 0; w < size; ++w) {
+            for (int j = 0; j < n; ++j) {
+                float ex = -TWOPI * ((w - size2) * points[first+j].x);
+                float ey = -TWOPI * ((w - size2) * points[first+j].y);
+                xr[w*chunk + j] = cosf(ex);
+                xi[w*chunk + j] = sinf(ex);
+                yr[w*chunk + j] = cosf(ey);
+                yi[w*chunk + j] = sinf(ey);
+            }
+        }
+        
+        std::vector<double> sx(chunk, 0.0), sy(chunk, 0.0);
+        std::vector<float> ar(chunk), ai(chunk), br(chunk), bi(chunk);
+        for (int y = 0; y < size; ++y) {
+            std::fill(ar.begin(), ar.end(), 0.f);
+            std::fill(ai.begin(), ai.end(), 0.f);
+            std::fill(br.begin(), br.end(), 0.f);
+            std::fill(bi.begin(), bi.end(), 0.f);
+            for (int x = 0; x < size; ++x) {
+                const float h_r = hr[x + y*size], h_i = hi[x + y*size];
+                if (h_r == 0.f && h_i == 0.f)
+                    continue;
+                const float wx = x - size2;
+                const float *pr = &xr[x*chunk], *pi = &xi[x*chunk];
+                for (int j = 0; j < n; ++j) {
+                    float zr = h_r * pr[j] - h_i * pi[j];
+                    float zi = h_r * pi[j] + h_i * pr[j];
+                    ar[j] += zr;
+                    ai[j] += zi;
+                    br[j] += wx * zr;
+                    bi[j] += wx * zi;
+                }
+            }
+            const float wy = y - size2;
+            for (int j = 0; j < n; ++j) {
+                const float qr = yr[y*chunk + j], qi = yi[y*chunk + j];
+                sx[j] += br[j] * qi + bi[j] * qr;
+                sy[j] += wy * (ar[j] * qi + ai[j] * qr);
+            }
+        }
+        for (int j = 0; j < n; ++j) {
+            gradient[2*(first+j)  ] = scale * sx[j];
+            gradient[2*(first+j)+1] = scale * sy[j];
+        }
+    }
+}
+
+float SpectralLoss(const Point *points, int npoints, int size,
+                   const float *target, const float *weights, float *gradient)
+{
+    if (npoints < 1 || size < 1)
+        return 0.f;
+    Spectrum s(size);
+    {
+        ProfileScope scope("ft");
+        Spectrum::PointSetSpectrumSeparable(&s, points, npoints);
+    }
+    std::vector<float> dldp(size * size);
+    double loss = 0;
+    for (int i = 0; i < size * size; ++i) {
+        const float u = s.ft[2*i], v = s.ft[2*i+1];
+        const float d = (u*u + v*v) / npoints - target[i];
+        loss += weights[i] * d * d;
+        dldp[i] = 2.f * weights[i] * d;
+    }
+    if (gradient)
+        PeriodogramGradient(points, npoints, s, dldp, gradient);
+    return loss;
+}
+
+float RingLoss(const Point *points, int npoints, const RingTarget &target,
+               float *gradient)
+{
+    const bool hasrp = target.rp.size() > 0, hasani = target.ani.size() > 0;
+    if (npoints < 1 || (!hasrp && !hasani))
+        return 0.f;
+    const Curve &layout = hasrp ? target.rp : target.ani;
+    assert(!hasrp || target.rpweights.size() == target.rp.size());
+    assert(!hasani || target.aniweights.size() == target.ani.size());
+    assert(!hasrp || !hasani || (target.rp.size() == target.ani.size() &&
+                                 target.rp.x1 == target.ani.x1));
+    const int size = 2 * std::max(1, (int) (layout.x1 + 0.5f));
+    const int size2 = size / 2;
+    
+    Spectrum s(size);
+    {
+        ProfileScope scope("ft");
+        Spectrum::PointSetSpectrumSeparable(&s, points, npoints);
+    }
+    Periodogram p(s);
+    p.Divide(npoints);
+    Curve rp(layout);
+    p.RadialPower(&rp);
+    
+    // Rings of all frequencies as in Periodogram::RadialPower(), -1 outside
+    std::vector<int> ring(size * size, -1);
+    std::vector<int> nr(rp.size(), 0);
+    for (int x = 0; x < size; ++x) {
+        for (int y = 0; y < size; ++y) {
+            int cx = abs(x - size2);
+            int cy = abs(y - size2);
+            int i = rp.ToIndex(sqrtf(cx*cx + cy*cy));
+            if (i < rp.size()) {
+                ring[x + y*size] = i;
+                nr[i]++;
+            }
+        }
+    }
+    
+    double loss = 0;
+    std::vector<float> dldp(size * size, 0.f);
+    if (hasrp) {
+        // dRP/dP(w) = 1 / Nr within the ring of w
+        std::vector<float> coef(rp.size(), 0.f);
+        for (int i = 0; i < rp.size(); ++i) {
+            const float d = rp[i] - target.rp[i];
+            loss += target.rpweights[i] * d * d;
+            if (nr[i] > 0)
+                coef[i] = 2.f * target.rpweights[i] * d / nr[i];
+        }
+        for (int i = 0; i < size * size; ++i)
+            if (ring[i] >= 0)
+                dldp[i] += coef[ring[i]];
+    }
+    if (hasani) {
+        // ANI = 10 log10(var / RP^2), with var the sample variance within the
+        // ring, whose derivative is 2 (P(w) - RP) / (Nr - 1)
+        std::vector<double> var(rp.size(), 0.0);
+        for (int i = 0; i < size * size; ++i)
+            if (ring[i] >= 0)
+                var[ring[i]] += (p.periodogram[i] - rp[ring[i]]) *
+                                (p.periodogram[i] - rp[ring[i]]);
+        std::vector<float> coef(rp.size(), 0.f);
+        for (int i = 0; i < rp.size(); ++i) {
+            if (nr[i] > 1)
+                var[i] /= nr[i] - 1;
+            // Rings without variance, e.g. of a single frequency, have no
+            // finite anisotropy and are left out
+            const float sqpow = rp[i] * rp[i];
+            if (sqpow > 0 && var[i] <= 0)
+                continue;
+            const float ani = Decibel(sqpow > 0 ? var[i] / sqpow : 1.f);
+            const float d = ani - target.ani[i];
+            loss += target.aniweights[i] * d * d;
+            if (sqpow > 0)
+                coef[i] = 2.f * target.aniweights[i] * d * 10.f / logf(10.f);
+        }
+        for (int i = 0; i < size * size; ++i) {
+            const int r = ring[i];
+            if (r < 0 || coef[r] == 0.f)
+                continue;
+            const float dvar = 2.f * (p.periodogram[i] - rp[r]) /
+                               std::max(nr[r] - 1, 1);
+            dldp[i] += coef[r] * (dvar / var[r] - 2.f / (rp[r] * nr[r]));
+        }
+    }
+    if (gradient)
+        PeriodogramGradient(points, npoints, s, dldp, gradient);
+    return loss;
+}
+
+
+// Difference a - b on the unit torus
+static inline void TorusDelta(const Point &a, const Point &b,
+                              float *dx, float *dy)
+{
+    *dx = a.x - b.x;
+    *dy = a.y - b.y;
+    *dx -= (*dx > .5f) ? 1.f : ((*dx < -.5f) ? -1.f : 0.f);
+    *dy -= (*dy > .5f) ? 1.f : ((*dy < -.5f) ? -1.f : 0.f);
+}
+
+// Calls f(j) for all points j in the neighbourhood of point i, where only
+// j > i are visited if later is set, and all j != i otherwise
+template <class F>
+static inline void Neighbours(const CellGrid &grid, int npoints, int i,
+                              bool later, F f)
+{
+    const int m = grid.m;
+    if (m == 1) {
+        for (int j = later ? i + 1 : 0; j < npoints; ++j)
+            if (j != i) f(j);
+        return;
+    }
+    const int cx = grid.cell[i] % m, cy = grid.cell[i] / m;
+    for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            int c = (cx + dx + m) % m + ((cy + dy + m) % m) * m;
+            for (int n = grid.start[c]; n < grid.start[c+1]; ++n) {
+                const int j = grid.order[n];
+                if (later ? j > i : j != i) f(j);
+            }
+        }
+    }
+}
+
+// Biweight kernel 15 / (16 c) (1 - (t / c)^2)^2 with cutoff c, whose standard
+// deviation is c / sqrt(7), and the layout of the RDF it is evaluated on
+struct PairKernel {
+    const Curve &layout;
+    float cutoff, norm;
+    
+    PairKernel(const Curve &layout, float sigma)
+        : layout(layout),
+          cutoff(sqrtf(7.f) * (sigma > 0.f ? sigma : layout.dx)),
+          norm(15.f / (16.f * cutoff)) {}
+    
+    float Center(int k) const { return layout.x0 + (k + 0.5f) * layout.dx; }
+    float Range() const { return layout.x1 + cutoff; }
+    
+    // Bins within the cutoff of distance d
+    void Bins(float d, int *first, int *last) const {
+        *first = std::max(0, (int) ceilf((d - cutoff - layout.x0) / layout.dx - 0.5f));
+        *last = std::min(layout.size() - 1,
+                         (int) floorf((d + cutoff - layout.x0) / layout.dx - 0.5f));
+    }
+    float K(float t) const {
+        const float u = t / cutoff, v = 1.f - u * u;
+        return v > 0.f ? norm * v * v : 0.f;
+    }
+    // Derivative of K(r - d) by d
+    float DK(float t) const {
+        const float u = t / cutoff, v = 1.f - u * u;
+        return v > 0.f ? 4.f * norm * u * v / cutoff : 0.f;
+    }
+};
+
+// Kernel sums of all pairs at every bin center, before normalization
+static void KernelSums(const Point *points, int npoints, const CellGrid &grid,
+                       const PairKernel &kernel, std::vector<double> *sums)
+{
+    const int nbins = kernel.layout.size();
+    const float range = kernel.Range();
+    sums->assign(nbins, 0.0);
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+{
+    std::vector<double> local(nbins, 0.0);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 64)
+#endif
+    for (int i = 0; i < npoints; ++i) {
+        Neighbours(grid, npoints, i, true, [&](int j) {
+            float dx, dy;
+            TorusDelta(points[i], points[j], &dx, &dy);
+            const float d = sqrtf(dx*dx + dy*dy);
+            if (d >= range)
+                return;
+            int first, last;
+            kernel.Bins(d, &first, &last);
+            for (int k = first; k <= last; ++k)
+                local[k] += kernel.K(kernel.Center(k) - d);
+        });
+    }
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+    for (int k = 0; k < nbins; ++k)
+        (*sums)[k] += local[k];
+}
+}
+
+// Pairs at distance r of a Poisson process with N points in the unit torus
+// have the density N (N - 1) / 2 * 2 pi r, which normalizes the RDF to one
+static inline float RDFNorm(int npoints, float r)
+{
+    return r > 0.f ? 1.f / (0.5f * npoints * (npoints - 1.f) * TWOPI * r) : 0.f;
+}
+
+void SmoothRDF(const Point *points, int npoints, float sigma, Curve *rdf)
+{
+    ProfileScope scope("smooth rdf");
+    rdf->SetZero();
+    if (npoints < 2 || rdf->size() == 0)
+        return;
+    PairKernel kernel(*rdf, sigma);
+    CellGrid grid;
+    grid.Build(points, npoints, kernel.Range());
+    std::vector<double> sums;
+    KernelSums(points, npoints, grid, kernel, &sums);
+    for (int k = 0; k < rdf->size(); ++k)
+        (*rdf)[k] = sums[k] * RDFNorm(npoints, kernel.Center(k));
+}
+
+float RDFLoss(const Point *points, int npoints, const RDFTarget &target,
+              float *gradient)
+{
+    const Curve &layout = target.rdf;
+    const int nbins = layout.size();
+    const bool weighted = target.weights.size() > 0;
+    assert(!weighted || target.weights.size() == nbins);
+    if (gradient)
+        std::fill(gradient, gradient + 2 * npoints, 0.f);
+    if (npoints < 2 || nbins == 0)
+        return 0.f;
+    
+    ProfileScope scope("rdf loss");
+    PairKernel kernel(layout, target.sigma);
+    CellGrid grid;
+    grid.Build(points, npoints, kernel.Range());
+    std::vector<double> sums;
+    KernelSums(points, npoints, grid, kernel, &sums);
+    
+    // dL/dK summed into bin k, i.e. 2 w (g - t) times the normalization
+    double loss = 0;
+    std::vector<float> dldk(nbins);
+    for (int k = 0; k < nbins; ++k) {
+        const float norm = RDFNorm(npoints, kernel.Center(k));
+        const float w = weighted ? target.weights[k] : 1.f;
+        const float d = sums[k] * norm - target.rdf[k];
+        loss += w * d * d;
+        dldk[k] = 2.f * w * d * norm;
+    }
+    if (!gradient)
+        return loss;
+    
+    // The distance d of a pair changes along the unit vector between the
+    // points
+    const float range = kernel.Range();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+    for (int i = 0; i < npoints; ++i) {
+        float gx = 0.f, gy = 0.f;
+        Neighbours(grid, npoints, i, false, [&](int j) {
+            float dx, dy;
+            TorusDelta(points[i], points[j], &dx, &dy);
+            const float d = sqrtf(dx*dx + dy*dy);
+            if (d >= range || d <= 0.f)
+                return;
+            int first, last;
+            kernel.Bins(d, &first, &last);
+            float dldd = 0.f;
+            for (int k = first; k <= last; ++k)
+                dldd += dldk[k] * kernel.DK(kernel.Center(k) - d);
+            gx += dldd * dx / d;
+            gy += dldd * dy / d;
+        });
+        gradient[2*i  ] = gx;
+        gradient[2*i+1] = gy;
+    }
+    return loss;
+}
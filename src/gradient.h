@@ -0,0 +1,72 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GRADIENT_H
+#define GRADIENT_H
+
+#include "curve.h"
+#include "point.h"
+
+// Losses of the periodogram P = |F|^2 / N of a point set against targets,
+// together with their gradients with respect to all point coordinates. The
+// derivative of P by a point reuses the phasors of the spectrum, so the
+// loss and all gradients cost a single O(N M^2) pass for an M x M spectrum.
+//
+// Losses are weighted sums of squared deviations from the target. Gradients
+// are written as interleaved dL/dx, dL/dy per point to gradient unless it is
+// NULL.
+
+// Per frequency. target and weights are in the layout of Periodogram, with
+// size frequencies per axis.
+float SpectralLoss(const Point *points, int npoints, int size,
+                   const float *target, const float *weights, float *gradient);
+
+// Per ring of the radial power and the anisotropy, with the layout of the
+// curves of psa, i.e. from 0 to the frequency range. Curves that are left
+// empty do not contribute.
+struct RingTarget {
+    Curve rp, rpweights;    // radial power and weight per ring
+    Curve ani, aniweights;  // anisotropy in dB and weight per ring
+};
+
+float RingLoss(const Point *points, int npoints, const RingTarget &target,
+               float *gradient);
+
+// RDF losses need a differentiable estimator in place of the histogram of
+// PointSet::RDF(). Every pair at distance d adds a kernel K(r - d) to the RDF
+// at the bin centers r, which are normalized like the histogram. K is the
+// biweight kernel with standard deviation sigma, which is smooth and vanishes
+// beyond a cutoff of sqrt(7) sigma. Pairs are found through a cell list, so the
+// RDF and the gradients cost O(N k) for k neighbours within range.
+struct RDFTarget {
+    Curve rdf;       // target RDF in the units of the unit torus
+    Curve weights;   // weight per bin, or empty for weights of one
+    float sigma;     // kernel width, or 0 for the bin width of rdf
+    
+    RDFTarget() : sigma(0.f) {}
+};
+
+// Smoothed RDF in the layout of rdf
+void SmoothRDF(const Point *points, int npoints, float sigma, Curve *rdf);
+float RDFLoss(const Point *points, int npoints, const RDFTarget &target,
+              float *gradient);
+
+#endif  // GRADIENT_H
@@ -23,6 +23,7 @@
 #include "util.h"
 #include <cassert>
 #include <cairo/cairo.h>
+#include <png.h>
 
 void Image::reallocate(int w, int h)
 {
@@ -93,12 +94,16 @@ void Image::GetRGBA(unsigned char*& data, bool flipped) const {
 
 void Image::ToneMap(bool square_root, float scale)
 {
-    for (int i = 0; i < width * height; ++i) {
-        float &f = pixels[i];
-        if (square_root) f = sqrtf(f);
-        f = Log2f(1.f + scale * f);
-        Clamp01(f);
-    }
+    for (int i = 0; i < width * height; ++i)
+        pixels[i] = ToneMapValue(pixels[i], square_root, scale);
+}
+
+float Image::ToneMapValue(float f, bool square_root, float scale)
+{
+    if (square_root) f = sqrtf(f);
+    f = Log2f(1.f + scale * f);
+    Clamp01(f);
+    return f;
 }
 
 void Image::Save(const std::string &fname, bool flipped)
@@ -114,3 +119,101 @@ void Image::Save(const std::string &fname, bool flipped)
     delete[] data;
 }
 
+
+
+bool ImageCollector::Begin(int width, int height)
+{
+    *image = Image(width, height);
+    y = height;
+    return true;
+}
+
+bool ImageCollector::Row(const float *row)
+{
+    if (y <= 0)
+        return false;
+    --y;
+    for (int x = 0; x < image->width; ++x)
+        image->SetPixel(x, y, row[x]);
+    return true;
+}
+
+
+PngStream::PngStream(const std::string &fname)
+    : fname(fname), file(NULL), png(NULL), info(NULL)
+{
+}
+
+void PngStream::Abort()
+{
+    if (png) {
+        png_structp p = (png_structp) png;
+        png_infop i = (png_infop) info;
+        png_destroy_write_struct(&p, &i);
+    }
+    if (file)
+        fclose(file);
+    file = NULL;
+    png = info = NULL;
+}
+
+bool PngStream::Begin(int width, int height)
+{
+    Abort();
+    file = fopen(fname.c_str(), "wb");
+    if (!file)
+        return false;
+    png_structp p = png_create_write_struct(PNG_LIBPNG_VER_STRING,
+                                            NULL, NULL, NULL);
+    png_infop i = p ? png_create_info_struct(p) : NULL;
+    png = p;
+    info = i;
+    if (!i || setjmp(png_jmpbuf(p))) {
+        Abort();
+        return false;
+    }
+    png_init_io(p, file);
+    png_set_IHDR(p, i, width, height, 8, PNG_COLOR_TYPE_GRAY,
+                 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(p, i);
+    data.resize(width);
+    return true;
+}
+
+bool PngStream::Row(const float *row)
+{
+    if (!png)
+        return false;
+    png_structp p = (png_structp) png;
+    // Same quantization as Image::GetRGBA
+    for (unsigned int x = 0; x < data.size(); ++x) {
+        float f = row[x];
+        Clamp01(f);
+        data[x] = (unsigned char)(f * 255.0f);
+    }
+    if (setjmp(png_jmpbuf(p))) {
+        Abort();
+        return false;
+    }
+    png_write_row(p, &data[0]);
+    return true;
+}
+
+bool PngStream::End()
+{
+    if (!png)
+        return false;
+    png_structp p = (png_structp) png;
+    if (setjmp(png_jmpbuf(p))) {
+        Abort();
+        return false;
+    }
+    png_write_end(p, NULL);
+    png_infop i = (png_infop) info;
+    png_destroy_write_struct(&p, &i);
+    png = info = NULL;
+    bool ok = fclose(file) == 0;
+    file = NULL;
+    return ok;
+}
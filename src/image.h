@@ -22,7 +22,9 @@
 #ifndef IMAGE_H
 #define IMAGE_H
 
+#include <cstdio>
 #include <string>
+#include <vector>
 
 class Image
 {    
@@ -45,8 +47,55 @@ public:
     void GetRGBA(unsigned char*& data, bool flipped = true) const;
     
     void ToneMap(bool square_root = false, float scale = 0.25f);
+    static float ToneMapValue(float f, bool square_root = false,
+                              float scale = 0.25f);
     void Save(const std::string &fname, bool flipped = true);
 };
 
+// Receives a tone-mapped image row by row from the top, e.g. from a
+// TiledSpectrum, so that the whole image need not be held in memory
+class ImageSink
+{
+public:
+    virtual ~ImageSink() {}
+    virtual bool Begin(int width, int height) = 0;
+    virtual bool Row(const float *row) = 0;
+    virtual bool End() = 0;
+};
+
+// Collects the rows in an Image, which is then saved as usual
+class ImageCollector : public ImageSink
+{
+    Image *image;
+    int y;
+
+public:
+    ImageCollector(Image *image) : image(image), y(0) {}
+    bool Begin(int width, int height);
+    bool Row(const float *row);
+    bool End() { return true; }
+};
+
+// Writes the rows straight to a grayscale PNG file, which is only created
+// once the first image begins
+class PngStream : public ImageSink
+{
+    std::string fname;
+    FILE *file;
+    void *png, *info;
+    std::vector<unsigned char> data;
+
+    void Abort();
+    PngStream(const PngStream &);
+    PngStream& operator= (const PngStream &);
+
+public:
+    PngStream(const std::string &fname);
+    ~PngStream() { Abort(); }
+    bool Begin(int width, int height);
+    bool Row(const float *row);
+    bool End();
+};
+
 #endif  // IMAGE_H
 
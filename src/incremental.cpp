@@ -0,0 +1,341 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "incremental.h"
+#include "profile.h"
+#include "util.h"
+
+
+IncrementalSpectrum::IncrementalSpectrum(const Config &config, int npoints)
+{
+    const float fnorm = 2.f / sqrtf(std::max(npoints, 1));
+    const int ftsize = std::max(1, (int) (config.frange / fnorm));
+    size = ftsize * 2;
+    re.assign(size * size, 0.f);
+    im.assign(size * size, 0.f);
+    for (int i = 0; i < 2; ++i)
+        phasors[i].resize(size * 4);
+    spectrum = Spectrum(size);
+    periodogram = Periodogram(size);
+    rp = Curve(ftsize * config.fbinsize, 0, ftsize);
+    ani = Curve(rp.size(), 0, ftsize);
+    Changed();
+}
+
+// The phasors e^(-2 pi i w x) of the frequencies w of one axis follow from
+// the first one by repeated rotation, so no trigonometric functions are
+// evaluated per frequency. The layout is re(x), im(x), re(y), im(y).
+void IncrementalSpectrum::Phasors(const Point &p, float *phasors) const
+{
+    const int size2 = size / 2;
+    const double coords[2] = { p.x, p.y };
+    for (int axis = 0; axis < 2; ++axis) {
+        float *pre = &phasors[2 * axis * size], *pim = pre + size;
+        const double a = -TWOPI * (double) coords[axis];
+        const double sr = cos(a), si = sin(a);
+        double r = cos(-size2 * a), m = sin(-size2 * a);
+        for (int w = 0; w < size; ++w) {
+            pre[w] = r;
+            pim[w] = m;
+            double t = r * sr - m * si;
+            m = r * si + m * sr;
+            r = t;
+        }
+    }
+}
+
+// Adds sign times the product of the x and y phasors to the spectrum. The
+// loops over x are unit stride on split real and imaginary parts.
+static void AddPhasors(int size, const float *phasors, float sign,
+                       float *re, float *im)
+{
+    const float *xre = phasors, *xim = phasors + size;
+    const float *yre = phasors + 2*size, *yim = phasors + 3*size;
+    for (int y = 0; y < size; ++y) {
+        const float br = sign * yre[y], bi = sign * yim[y];
+        float *r = &re[y*size], *m = &im[y*size];
+        for (int x = 0; x < size; ++x) {
+            r[x] += xre[x] * br - xim[x] * bi;
+            m[x] += xre[x] * bi + xim[x] * br;
+        }
+    }
+}
+
+// Replaces the phasors of one point by those of another in a single pass
+static void MovePhasors(int size, const float *from, const float *to,
+                        float *re, float *im)
+{
+    const float *are = from, *aim = from + size;
+    const float *bre = to, *bim = to + size;
+    for (int y = 0; y < size; ++y) {
+        const float cr = from[2*size + y], ci = from[3*size + y];
+        const float dr = to[2*size + y], di = to[3*size + y];
+        float *r = &re[y*size], *m = &im[y*size];
+        for (int x = 0; x < size; ++x) {
+            r[x] += (bre[x] * dr - bim[x] * di) - (are[x] * cr - aim[x] * ci);
+            m[x] += (bre[x] * di + bim[x] * dr) - (are[x] * ci + aim[x] * cr);
+        }
+    }
+}
+
+void IncrementalSpectrum::Changed()
+{
+    hasspectrum = hasperiodogram = hasrp = hasani = false;
+}
+
+void IncrementalSpectrum::Assign(const Point *points, int npoints)
+{
+    this->points.assign(points, points + npoints);
+    Recompute();
+}
+
+int IncrementalSpectrum::Insert(const Point &p)
+{
+    Phasors(p, &phasors[0][0]);
+    AddPhasors(size, &phasors[0][0], 1.f, &re[0], &im[0]);
+    points.push_back(p);
+    Changed();
+    return (int) points.size() - 1;
+}
+
+void IncrementalSpectrum::Remove(int index)
+{
+    Phasors(points[index], &phasors[0][0]);
+    AddPhasors(size, &phasors[0][0], -1.f, &re[0], &im[0]);
+    points[index] = points.back();
+    points.pop_back();
+    Changed();
+}
+
+void IncrementalSpectrum::Move(int index, const Point &p)
+{
+    Phasors(points[index], &phasors[0][0]);
+    Phasors(p, &phasors[1][0]);
+    MovePhasors(size, &phasors[0][0], &phasors[1][0], &re[0], &im[0]);
+    points[index] = p;
+    Changed();
+}
+
+void IncrementalSpectrum::Recompute()
+{
+    ProfileScope scope("ft");
+    Spectrum s(size);
+    if (!points.empty())
+        Spectrum::PointSetSpectrumSeparable(&s, &points[0], points.size());
+    for (int i = 0; i < size * size; ++i) {
+        re[i] = s.ft[2*i];
+        im[i] = s.ft[2*i+1];
+    }
+    Changed();
+}
+
+const Spectrum &IncrementalSpectrum::GetSpectrum()
+{
+    if (!hasspectrum) {
+        for (int i = 0; i < size * size; ++i) {
+            spectrum.ft[2*i] = re[i];
+            spectrum.ft[2*i+1] = im[i];
+        }
+        hasspectrum = true;
+    }
+    return spectrum;
+}
+
+const Periodogram &IncrementalSpectrum::GetPeriodogram()
+{
+    if (!hasperiodogram) {
+        ProfileScope scope("periodogram");
+        for (int i = 0; i < size * size; ++i)
+            periodogram.periodogram[i] = re[i] * re[i] + im[i] * im[i];
+        if (!points.empty())
+            periodogram.Divide(points.size());
+        hasperiodogram = true;
+    }
+    return periodogram;
+}
+
+const Curve &IncrementalSpectrum::RadialPower()
+{
+    if (!hasrp) {
+        GetPeriodogram();
+        ProfileScope scope("rp");
+        periodogram.RadialPower(&rp);
+        hasrp = true;
+    }
+    return rp;
+}
+
+const Curve &IncrementalSpectrum::Anisotropy()
+{
+    if (!hasani) {
+        RadialPower();
+        ProfileScope scope("ani");
+        periodogram.Anisotropy(&ani, rp);
+        hasani = true;
+    }
+    return ani;
+}
+
+
+IncrementalRDF::IncrementalRDF(const Curve &layout) : rdfs(1, layout)
+{
+    Init();
+}
+
+IncrementalRDF::IncrementalRDF(const std::vector<Curve> &layouts)
+    : rdfs(layouts)
+{
+    Init();
+}
+
+// With fewer than three cells per side the neighbourhood would visit cells
+// twice, so a single cell is used instead, as in PointSet::RDFCellList()
+void IncrementalRDF::Init()
+{
+    float range = 0.f;
+    bins.resize(rdfs.size());
+    for (size_t k = 0; k < rdfs.size(); ++k) {
+        range = std::max(range, rdfs[k].x0 + rdfs[k].size() * rdfs[k].dx);
+        bins[k].assign(rdfs[k].size(), 0);
+    }
+    m = range > 0.f ? std::min(1024, (int) (1.f / range)) : 1024;
+    m = (m < 3) ? 1 : m;
+    cells.assign(m * m, std::vector<int>());
+    normalized = false;
+}
+
+int IncrementalRDF::CellOf(const Point &p) const
+{
+    int cx = std::max(0, std::min(m - 1, (int) (p.x * m)));
+    int cy = std::max(0, std::min(m - 1, (int) (p.y * m)));
+    return cx + cy * m;
+}
+
+// Adds or removes the pairs of p, standing in for point index, with all
+// other points in its neighbourhood
+void IncrementalRDF::Bin(int index, const Point &p, bool add)
+{
+    const int c = CellOf(p), cx = c % m, cy = c / m;
+    const int reach = (m == 1) ? 0 : 1;
+    for (int dy = -reach; dy <= reach; ++dy) {
+        for (int dx = -reach; dx <= reach; ++dx) {
+            const std::vector<int> &n = cells[(cx + dx + m) % m +
+                                              ((cy + dy + m) % m) * m];
+            for (size_t i = 0; i < n.size(); ++i) {
+                if (n[i] == index) continue;
+                float dist = p.DistUnitTorus(points[n[i]]);
+                for (size_t k = 0; k < rdfs.size(); ++k) {
+                    int idx = rdfs[k].ToIndex(dist);
+                    if (0 <= idx && idx < rdfs[k].size()) {
+                        if (add) bins[k][idx]++;
+                        else     bins[k][idx]--;
+                    }
+                }
+            }
+        }
+    }
+    normalized = false;
+}
+
+void IncrementalRDF::Link(int index)
+{
+    cell[index] = CellOf(points[index]);
+    slot[index] = cells[cell[index]].size();
+    cells[cell[index]].push_back(index);
+}
+
+void IncrementalRDF::Unlink(int index)
+{
+    std::vector<int> &n = cells[cell[index]];
+    const int moved = n.back();
+    n[slot[index]] = moved;
+    slot[moved] = slot[index];
+    n.pop_back();
+}
+
+void IncrementalRDF::Assign(const Point *points, int npoints)
+{
+    this->points.assign(points, points + npoints);
+    cell.resize(npoints);
+    slot.resize(npoints);
+    cells.assign(m * m, std::vector<int>());
+    for (size_t k = 0; k < rdfs.size(); ++k)
+        bins[k].assign(rdfs[k].size(), 0);
+    
+    // Each pair is counted once, when its second point is linked
+    for (int i = 0; i < npoints; ++i) {
+        Bin(-1, points[i], true);
+        Link(i);
+    }
+}
+
+int IncrementalRDF::Insert(const Point &p)
+{
+    const int index = points.size();
+    points.push_back(p);
+    cell.push_back(0);
+    slot.push_back(0);
+    Bin(index, p, true);
+    Link(index);
+    return index;
+}
+
+void IncrementalRDF::Remove(int index)
+{
+    Unlink(index);
+    Bin(index, points[index], false);
+    const int last = points.size() - 1;
+    if (index != last) {
+        // The last point takes over the index
+        cells[cell[last]][slot[last]] = index;
+        points[index] = points[last];
+        cell[index] = cell[last];
+        slot[index] = slot[last];
+    }
+    points.pop_back();
+    cell.pop_back();
+    slot.pop_back();
+}
+
+void IncrementalRDF::Move(int index, const Point &p)
+{
+    Bin(index, points[index], false);
+    Unlink(index);
+    points[index] = p;
+    Link(index);
+    Bin(index, p, true);
+}
+
+const Curve &IncrementalRDF::GetRDF(int k)
+{
+    if (!normalized) {
+        std::vector<Curve *> curves;
+        for (size_t i = 0; i < rdfs.size(); ++i)
+            curves.push_back(&rdfs[i]);
+        if (points.size() > 1)
+            NormalizeRDF(points.size(), bins, curves);
+        else
+            for (size_t i = 0; i < rdfs.size(); ++i)
+                rdfs[i].SetZero();
+        normalized = true;
+    }
+    return rdfs[k];
+}
@@ -0,0 +1,121 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include "config.h"
+#include "curve.h"
+#include "periodogram.h"
+#include "point.h"
+#include "spectrum.h"
+#include <vector>
+
+// Spectrum of a point set that changes a few points at a time, e.g. in a
+// blue noise optimizer. The spectrum is a sum over the points, so inserting,
+// removing or moving a point updates it in O(M^2) for an M x M spectrum,
+// independent of the number of points. The periodogram, RP and ANI are only
+// recomputed when asked for after a change.
+//
+// Updates accumulate float round-off; Recompute() sums the spectrum afresh.
+// An object may not be used by several threads at the same time.
+class IncrementalSpectrum
+{
+public:
+    // Spectrum and curves with the frequency range of config for sets of
+    // npoints points, which stays fixed as points are inserted and removed
+    IncrementalSpectrum(const Config &config, int npoints);
+    
+    // Replaces all points
+    void Assign(const Point *points, int npoints);
+    // Adds a point and returns its index
+    int Insert(const Point &p);
+    // Removes a point; the last point takes over its index
+    void Remove(int index);
+    void Move(int index, const Point &p);
+    void Recompute();
+    
+    int NumPoints() const { return (int) points.size(); }
+    const Point &GetPoint(int index) const { return points[index]; }
+    const std::vector<Point> &GetPoints() const { return points; }
+    
+    // Measures of the current points, normalized as in PsaResult
+    const Spectrum &GetSpectrum();
+    const Periodogram &GetPeriodogram();
+    const Curve &RadialPower();
+    const Curve &Anisotropy();
+
+private:
+    int size;
+    std::vector<Point> points;
+    std::vector<float> re, im;           // spectrum, at x + y*size
+    std::vector<float> phasors[2];       // per-axis phasors of two points
+    Spectrum spectrum;
+    Periodogram periodogram;
+    Curve rp, ani;
+    bool hasspectrum, hasperiodogram, hasrp, hasani;
+    
+    void Phasors(const Point &p, float *phasors) const;
+    void Changed();
+};
+
+// RDFs of a point set that changes a few points at a time. The counts of
+// pairs per bin are kept, and a change updates them by the pairs of the
+// changed point with its neighbours, which are found in O(k) through a cell
+// list as coarse as the largest curve range, or in O(N) for the full range.
+// The counts are exact, so the RDFs equal those of PointSet::RDF().
+class IncrementalRDF
+{
+public:
+    // RDFs with the ranges and bins of the given curves
+    explicit IncrementalRDF(const Curve &layout);
+    explicit IncrementalRDF(const std::vector<Curve> &layouts);
+    
+    void Assign(const Point *points, int npoints);
+    int Insert(const Point &p);
+    // Removes a point; the last point takes over its index
+    void Remove(int index);
+    void Move(int index, const Point &p);
+    
+    int NumPoints() const { return (int) points.size(); }
+    const Point &GetPoint(int index) const { return points[index]; }
+    const std::vector<Point> &GetPoints() const { return points; }
+    
+    // Normalized RDF of the k-th layout
+    const Curve &GetRDF(int k = 0);
+
+private:
+    int m;                                  // cells per side
+    std::vector<Point> points;
+    std::vector<int> cell, slot;            // cell and index within it
+    std::vector<std::vector<int> > cells;   // points in each cell
+    std::vector<Curve> rdfs;
+    std::vector<std::vector<unsigned long> > bins;
+    bool normalized;
+    
+    void Init();
+    int CellOf(const Point &p) const;
+    void Bin(int index, const Point &p, bool add);
+    void Link(int index);
+    void Unlink(int index);
+};
+
+#endif  // INCREMENTAL_H
@@ -25,16 +25,56 @@
 #include "analysis.h"
 #include "config.h"
 #include "param.h"
+#include "profile.h"
+#include "serve.h"
 #include <vector>
 
 
 void Usage() {
     std::cout << "usage: psa filename [options]\n"
+        "Use - as filename to read a stream of point sets from stdin.\n"
         "General options\n"
         "  --help            show this message\n"
         "  --convert ext     converts all given files to files with extension ext\n"
+        "  --qbits n         bits per coordinate for .qps output (8-31, default 24)\n"
         "  --summary         single PDF with most measures (default)\n"
         "  --avg             average the measures over all given files\n"
+        "  --pack file       packs all given point sets into one MPS container\n"
+        "  --double          store float64 coordinates in MPS containers\n"
+        "  --writers n       number of threads writing output files (default 1,\n"
+        "                    0 writes them before analyzing the next file)\n"
+        "  --stream fmt      format of point sets read from stdin ('-'), either\n"
+        "                    'txt' blocks or length-prefixed 'rps' frames\n"
+        "  --serve socket    answers analysis requests on a Unix domain socket\n"
+        "  --profile file    write a Chrome trace with the time spent in each\n"
+        "                    stage, counters and the peak memory use\n"
+        "  --perf            with --profile, also record hardware counters of\n"
+        "                    each stage (Linux perf events)\n"
+        "  --rdf-target file score each set by the loss of its smoothed RDF\n"
+        "                    against the curve in file, see src/gradient.h\n"
+        "  --rdf-sigma s     width of the RDF kernel (default: bin width)\n"
+        "  --window c,c,w,h  write the power spectrum in the window of the given\n"
+        "                    center and size, in units of frange, to _window.png\n"
+        "                    (and _window.txt with --raw)\n"
+        "  --wstep s         frequency step of the window (default 1, the grid)\n"
+        "  --query file      write the power spectrum at the frequencies x y\n"
+        "                    listed in file, in units of frange, to _query.txt\n"
+        "  --engines spec    engines of the FT, RDF and Hankel stages: 'auto'\n"
+        "                    (tuned, default), 'reference', or pairs such as\n"
+        "                    'ft=separable,rdf=cells,hankel=windowed'\n"
+        "  --ftmemory mb     compute frequency grids larger than mb megabytes in\n"
+        "                    bands of rows, see ftmemory in psa.cfg\n"
+        "  --downsample n    downsample the spectrum images of banded grids\n"
+        "  --rpangles n      sample at most n frequencies per ring for the RP and\n"
+        "                    ANI when no spectrum image is written\n"
+        "  --rdfanchors n    sample the RDFs from the pairs of n random anchor\n"
+        "                    points, with standard errors in a third column of\n"
+        "                    --raw output\n"
+        "  --rdftime s       sample the RDFs for at most s seconds\n"
+        "  --rdfprecision e  sample the RDFs until their RMS standard error is\n"
+        "                    below e\n"
+        "  --chunk n         read RPS files and MPS sets in blocks of n points\n"
+        "                    instead of loading them; skips spatial statistics\n"
         "Statistics\n"
         "  --spatial         Global mindist, average mindist"
 #ifdef PSA_HAS_CGAL
@@ -59,8 +99,29 @@ int main(int argc, char * const argv[])
     ParamList params;
     params.Define("help", "false");
     params.Define("convert", "");
+    params.Define("qbits", "24");
     params.Define("summary", "false");
     params.Define("avg", "false");
+    params.Define("pack", "");
+    params.Define("double", "false");
+    params.Define("stream", "txt");
+    params.Define("writers", "1");
+    params.Define("serve", "");
+    params.Define("profile", "");
+    params.Define("perf", "false");
+    params.Define("engines", "");
+    params.Define("ftmemory", "");
+    params.Define("downsample", "");
+    params.Define("chunk", "0");
+    params.Define("rpangles", "");
+    params.Define("rdfanchors", "");
+    params.Define("rdftime", "");
+    params.Define("rdfprecision", "");
+    params.Define("rdf-target", "");
+    params.Define("rdf-sigma", "0");
+    params.Define("window", "");
+    params.Define("wstep", "1");
+    params.Define("query", "");
     params.Define("spatial", "false");
     params.Define("spectral", "false");
     params.Define("stats", "false");
@@ -73,7 +134,8 @@ int main(int argc, char * const argv[])
     std::vector<std::string> input;
     params.Parse(argc, argv, input);
     
-    bool show_usage = params.GetBool("help") || input.empty();
+    std::string serve = params.GetString("serve");
+    bool show_usage = params.GetBool("help") || (input.empty() && serve.empty());
     if (const Param *p = params.UnusedOption()) {
         fprintf(stderr, "Unknown option '%s'.\n", p->name.c_str());
         show_usage = true;
@@ -83,11 +145,57 @@ int main(int argc, char * const argv[])
         exit(0);
     }
     
+    std::string profile = params.GetString("profile");
+    if (!profile.empty())
+        Profile::Start(params.GetBool("perf"));
+    
     Config config = LoadConfig("common/psa.cfg");
+    std::string engines = params.GetString("engines");
+    if (!engines.empty() && !ParseEngines(engines, &config.engines)) {
+        std::cerr << "Invalid engines '" << engines << "'.\n";
+        exit(1);
+    }
+    if (!params.GetString("ftmemory").empty())
+        config.ftmemory = std::max(params.GetFloat("ftmemory"), 0.f);
+    if (!params.GetString("downsample").empty())
+        config.ftdownsample = std::max(params.GetInt("downsample"), 1);
+    if (!params.GetString("rpangles").empty())
+        config.rpangles = std::max(params.GetInt("rpangles"), 0);
+    if (!params.GetString("rdfanchors").empty())
+        config.rdfanchors = std::max(params.GetInt("rdfanchors"), 0);
+    if (!params.GetString("rdftime").empty())
+        config.rdftime = std::max(params.GetFloat("rdftime"), 0.f);
+    if (!params.GetString("rdfprecision").empty())
+        config.rdfprecision = std::max(params.GetFloat("rdfprecision"), 0.f);
+    if (!serve.empty()) {
+        Serve(serve, config);
+        return 0;
+    }
     
-    if (params.GetBool("avg"))
+    ExpandContainers(input);
+    if (!params.GetString("pack").empty())
+        Pack(input, params);
+    
+    if (!params.GetString("rdf-target").empty())
+        ScoreRDF(input, params);
+    else if (!params.GetString("window").empty())
+        SpectrumWindows(input, params, config);
+    else if (!params.GetString("query").empty())
+        SpectrumQueries(input, params);
+    else if (params.GetBool("avg"))
         AnalysisAverage(input, params, config);
+    else if (params.GetInt("chunk") > 0)
+        AnalysisChunked(input, params, config);
     else
         Analysis(input, params, config);
+    
+    if (!profile.empty()) {
+        bool written = Profile::Write(profile);
+        Profile::Stop();
+        if (!written) {
+            std::cerr << "Cannot create '" << profile << "'.\n";
+            exit(1);
+        }
+    }
 }
 
@@ -0,0 +1,114 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "measures.h"
+#include <cassert>
+
+
+// Every measure is derived from exactly one other intermediate
+static const Measure Dependencies[NumMeasures] = {
+    MeasurePoints,          // Points
+    MeasurePoints,          // PairHistogram
+    MeasurePairHistogram,   // RDF
+    MeasurePairHistogram,   // FullRDF
+    MeasureFullRDF,         // RPFromRDF
+    MeasureRPFromRDF,       // SpectralStats
+    MeasurePoints,          // Spectrum
+    MeasureSpectrum,        // Periodogram
+    MeasurePeriodogram,     // RP
+    MeasureRP,              // Anisotropy
+    MeasurePeriodogram,     // Image
+    MeasurePoints,          // Triangulation
+    MeasureTriangulation    // SpatialStats
+};
+
+static const char *Names[NumMeasures] = {
+    "points", "pair histogram", "rdf", "full rdf", "rp from rdf",
+    "spectral stats", "spectrum", "periodogram", "rp", "anisotropy",
+    "spectrum image", "triangulation", "spatial stats"
+};
+
+// Command line options and the measures they ask for
+static const struct {
+    const char *option;
+    Measure measures[2];
+    int nmeasures;
+} Options[] = {
+    { "spatial",   { MeasureSpatialStats },                       1 },
+    { "spectral",  { MeasureSpectralStats },                      1 },
+    { "stats",     { MeasureSpatialStats, MeasureSpectralStats }, 2 },
+    { "rp",        { MeasureRP },                                 1 },
+    { "rdf",       { MeasureRDF },                                1 },
+    { "ani",       { MeasureAnisotropy },                         1 },
+    { "pspectrum", { MeasureImage },                              1 }
+};
+static const int NumOptions = sizeof(Options) / sizeof(Options[0]);
+
+
+MeasureGraph::MeasureGraph() {
+    for (int i = 0; i < NumMeasures; ++i)
+        needed[i] = requested[i] = false;
+}
+
+void MeasureGraph::Request(Measure m) {
+    assert(0 <= m && m < NumMeasures);
+    requested[m] = true;
+    while (!needed[m]) {
+        needed[m] = true;
+        m = Dependencies[m];
+    }
+}
+
+bool MeasureGraph::Empty() const {
+    for (int i = 0; i < NumMeasures; ++i)
+        if (needed[i] && i != MeasurePoints)
+            return false;
+    return true;
+}
+
+Measure MeasureGraph::Dependency(Measure m) {
+    return Dependencies[m];
+}
+
+const char *MeasureGraph::Name(Measure m) {
+    return Names[m];
+}
+
+// Without any explicit output option, psa writes a summary of everything
+MeasureGraph MeasureGraph::FromParams(ParamList &params, bool *summary) {
+    MeasureGraph graph;
+    bool other = !params.GetString("convert").empty() ||
+                 !params.GetString("pack").empty();
+    for (int i = 0; i < NumOptions; ++i) {
+        if (!params.GetBool(Options[i].option))
+            continue;
+        for (int j = 0; j < Options[i].nmeasures; ++j)
+            graph.Request(Options[i].measures[j]);
+        other = true;
+    }
+    *summary = params.GetBool("summary") || !other;
+    if (*summary) {
+        for (int i = 0; i < NumOptions; ++i)
+            for (int j = 0; j < Options[i].nmeasures; ++j)
+                graph.Request(Options[i].measures[j]);
+    }
+    return graph;
+}
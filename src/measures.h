@@ -0,0 +1,71 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MEASURES_H
+#define MEASURES_H
+
+#include "param.h"
+
+// Measures and the intermediate results they are derived from. Requesting a
+// measure also requests everything it depends on, so that an analysis
+// computes each intermediate at most once and nothing that is not needed:
+//
+//   points -> pair histogram -> RDF
+//                            -> full RDF -> RP from RDF -> spectral stats
+//   points -> spectrum -> periodogram -> RP -> anisotropy
+//                                     -> spectrum image
+//   points -> triangulation -> spatial stats
+enum Measure {
+    MeasurePoints,
+    MeasurePairHistogram,
+    MeasureRDF,
+    MeasureFullRDF,
+    MeasureRPFromRDF,
+    MeasureSpectralStats,
+    MeasureSpectrum,
+    MeasurePeriodogram,
+    MeasureRP,
+    MeasureAnisotropy,
+    MeasureImage,
+    MeasureTriangulation,
+    MeasureSpatialStats,
+    NumMeasures
+};
+
+class MeasureGraph
+{
+    bool needed[NumMeasures];
+    bool requested[NumMeasures];
+public:
+    MeasureGraph();
+    
+    void Request(Measure m);
+    bool Needs(Measure m) const { return needed[m]; }
+    // Whether m was requested itself rather than as a dependency
+    bool Requested(Measure m) const { return requested[m]; }
+    bool Empty() const;
+    
+    static Measure Dependency(Measure m);
+    static const char *Name(Measure m);
+    static MeasureGraph FromParams(ParamList &params, bool *summary);
+};
+
+#endif  // MEASURES_H
@@ -82,6 +82,10 @@ Param *ParamList::Insert(const std::string &key) {
 void ParamList::Parse(int argc, char * const argv[], std::vector<std::string> &args) {
     for (int index = 1; index < argc; index++) {
         std::string arg = argv[index];
+        if (arg == "-") {
+            args.push_back(arg);
+            continue;
+        }
         size_t eqpos = arg.find("=");
         size_t beg = arg.find_first_not_of("-");
         std::string name = arg.substr(beg, eqpos-beg);
@@ -44,7 +44,13 @@ Periodogram::Periodogram(const Spectrum &s) {
     }
 }
 
+Periodogram::Periodogram(const Periodogram &p) {
+    this->periodogram = NULL;
+    *this = p;
+}
+
 Periodogram& Periodogram::operator= (const Periodogram &p) {
+    if (this == &p) return *this;
     this->size = p.size;
     if (this->periodogram) delete[] periodogram;
     this->periodogram = new float[size * size];
@@ -69,7 +75,13 @@ void Periodogram::Anisotropy(Curve *ani) const {
     // Determine radial power curve first, using the same parameters as 'ani'
     Curve rp = *ani;
     this->RadialPower(&rp);
-    // Now determine anisotropy curve
+    this->Anisotropy(ani, rp);
+}
+
+// Anisotropy based on an already computed radial power curve 'rp', which
+// must have the same parameters as 'ani'
+void Periodogram::Anisotropy(Curve *ani, const Curve &rp) const {
+    assert(rp.size() == ani->size() && rp.x0 == ani->x0 && rp.x1 == ani->x1);
     const int size2 = size / 2;
     std::vector<unsigned long> Nr(ani->size(), 0);
     ani->SetZero();
@@ -35,12 +35,14 @@ public:
     Periodogram() { periodogram = NULL; size = 0; }
     Periodogram(int size);
     Periodogram(const Spectrum &s);
+    Periodogram(const Periodogram &p);
     Periodogram& operator= (const Periodogram &p);
     ~Periodogram() { if (periodogram) delete[] periodogram; }
     
     void Accumulate(const Periodogram &p);
     void Divide(const float f);
-    void Anisotropy(Curve *rp) const;
+    void Anisotropy(Curve *ani) const;
+    void Anisotropy(Curve *ani, const Curve &rp) const;
     void RadialPower(Curve *rp) const;
     void ToImage(Image *img) const;
 };
@@ -21,21 +21,24 @@
 
 #include "point.h"
 
+#include "compress.h"
+#include "profile.h"
 #include "util.h"
 #include <algorithm>
+#include <cctype>
 #include <fstream>
+#include <climits>
+#include <sstream>
 #include <stdint.h>
+#include <sys/stat.h>
+#if !defined(_WIN32) && !defined(_WIN64) && !defined(_MSC_VER)
+#include <sys/types.h>
+#endif
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
-enum Endianness {
-    BigEndian, LittleEndian
-};
-
-static Endianness SystemEndianness() {
-    union { uint32_t i; char c[4]; } e;
-    e.i = 1;
-    return e.c[0] == 0 ? BigEndian : LittleEndian;
-}
 
 static void SwapEndian4(uint8_t *buf, int nn) {
     for (int i=0; i<nn; i++) {
@@ -76,6 +79,68 @@ static bool WriteFloats(FILE *fp, const float *p, int n, Endianness endian) {
     return true;
 }
 
+template <typename T>
+static bool ReadValues(FILE *fp, T *p, int n, Endianness endian) {
+    if (fread(p, sizeof(T), n, fp) != (size_t)n)
+        return false;
+    if (endian != SystemEndianness())
+        SwapEndian(p, n);
+    return true;
+}
+
+template <typename T>
+static bool WriteValues(FILE *fp, const T *p, int n, Endianness endian) {
+    if (endian == SystemEndianness())
+        return fwrite(p, sizeof(T), n, fp) == (size_t)n;
+    std::vector<T> buf(p, p + n);
+    SwapEndian(&buf[0], n);
+    return fwrite(&buf[0], sizeof(T), n, fp) == (size_t)n;
+}
+
+static int Seek64(FILE *fp, uint64_t pos) {
+#if defined(_WIN32) || defined(_WIN64) || defined(_MSC_VER)
+    return _fseeki64(fp, (__int64) pos, SEEK_SET);
+#else
+    return fseeko(fp, (off_t) pos, SEEK_SET);
+#endif
+}
+
+// Size of an open file in bytes, or 0 if unknown
+static uint64_t FileSize(FILE *fp) {
+#if defined(_WIN32) || defined(_WIN64) || defined(_MSC_VER)
+    struct _stat64 st;
+    if (_fstat64(_fileno(fp), &st) != 0)
+        return 0;
+#else
+    struct stat st;
+    if (fstat(fileno(fp), &st) != 0)
+        return 0;
+#endif
+    return st.st_size > 0 ? (uint64_t) st.st_size : 0;
+}
+
+// Reads n bytes at the given offset without touching the stream position,
+// so that several threads can read from the same container concurrently
+static bool ReadAt(FILE *fp, uint64_t pos, void *buf, size_t n) {
+#if defined(_WIN32) || defined(_WIN64) || defined(_MSC_VER)
+    bool ok;
+#ifdef _OPENMP
+#pragma omp critical (ReadAt)
+#endif
+    ok = Seek64(fp, pos) == 0 && fread(buf, 1, n, fp) == n;
+    return ok;
+#else
+    uint8_t *p = static_cast<uint8_t *>(buf);
+    while (n > 0) {
+        ssize_t nn = pread(fileno(fp), p, n, (off_t) pos);
+        if (nn <= 0)
+            return false;
+        p += nn; pos += nn; n -= nn;
+    }
+    return true;
+#endif
+}
+
 static bool HasSuffix(const std::string &s, const std::string &suffix) {
     int i = s.size() - suffix.size();
     if (i >= 0)
@@ -83,61 +148,322 @@ static bool HasSuffix(const std::string &s, const std::string &suffix) {
     return false;
 }
 
+static const char MPSMagic[4] = { 'P', 'S', 'A', 'M' };
+static const uint32_t MPSVersion = 1;
+static const uint32_t MPSDouble = 1;
+static const int MPSHeaderSize = 16;
+
 
 void PointSet::RDF(Curve *rdf) const
 {
-    const int npoints = this->size();
-    std::vector<unsigned long> bins(rdf->size(), 0);
+    std::vector<Curve *> rdfs(1, rdf);
+    RDF(rdfs);
+}
+
+void PointSet::RDF(const std::vector<Curve *> &rdfs) const
+{
+    RDF(points.empty() ? NULL : &points[0], size(), rdfs);
+}
+
+void NormalizeRDF(int npoints,
+                  const std::vector<std::vector<unsigned long> > &bins,
+                  const std::vector<Curve *> &rdfs)
+{
+    for (size_t k = 0; k < rdfs.size(); ++k) {
+        Curve *rdf = rdfs[k];
+        // The pair count overflows an int beyond 46341 points
+        const float pairs = 0.5 * npoints * (npoints - 1.0);
+        const float scale = pairs * PI * rdf->dx * rdf->dx;
+        for (int i = 0; i < rdf->size(); ++i)
+            (*rdf)[i] = bins[k][i] / (scale * (2*i + 1));
+    }
+}
+
+// Bins every pair distance into each of the given curves, so that RDFs with
+// different ranges or resolutions share a single pass over all pairs
+void PointSet::RDF(const Point *points, int npoints,
+                   const std::vector<Curve *> &rdfs)
+{
+    Profile::Count(CounterPairs, 0.5 * npoints * (npoints - 1.0));
+    const int ncurves = rdfs.size();
+    std::vector<std::vector<unsigned long> > bins(ncurves);
+    for (int k = 0; k < ncurves; ++k)
+        bins[k].assign(rdfs[k]->size(), 0);
     
     for (int i = 0; i < npoints; ++i) {
         for (int j = i + 1; j < npoints; ++j) {
             float dist = points[i].DistUnitTorus(points[j]);
-            int idx = rdf->ToIndex(dist);
-            if (0 <= idx && idx < rdf->size())
-                bins[idx]++;
+            for (int k = 0; k < ncurves; ++k) {
+                int idx = rdfs[k]->ToIndex(dist);
+                if (0 <= idx && idx < rdfs[k]->size())
+                    bins[k][idx]++;
+            }
         }
     }
     
-    const float scale = npoints * (npoints - 1)/2 * PI * rdf->dx * rdf->dx;
-    for (int i = 0; i < rdf->size(); ++i)
-        (*rdf)[i] = bins[i] / (scale * (2*i + 1));
+    NormalizeRDF(npoints, bins, rdfs);
+}
+
+// With fewer than three cells per side the neighbourhood would visit cells
+// twice, so a single cell is used instead
+void CellGrid::Build(const Point *points, int npoints, float range)
+{
+    m = range > 0.f ? std::min(1024, (int) (1.f / range)) : 1024;
+    m = (m < 3) ? 1 : m;
+    cell.resize(npoints);
+    order.resize(npoints);
+    start.assign(m*m + 1, 0);
+    for (int i = 0; i < npoints; ++i) {
+        cell[i] = Cell(points[i]);
+        start[cell[i] + 1]++;
+    }
+    for (int c = 0; c < m*m; ++c)
+        start[c+1] += start[c];
+    std::vector<int> fill(start.begin(), start.end() - 1);
+    for (int i = 0; i < npoints; ++i)
+        order[fill[cell[i]]++] = i;
+}
+
+// Bins the pairs of p and the points j > after in order[begin, end)
+static inline void BinCell(const Point &p, const Point *points,
+                           const std::vector<int> &order, int begin, int end,
+                           int after, const std::vector<Curve *> &rdfs,
+                           std::vector<std::vector<unsigned long> > &bins)
+{
+    const int ncurves = rdfs.size();
+    for (int n = begin; n < end; ++n) {
+        const int j = order[n];
+        if (j <= after) continue;
+        float dist = p.DistUnitTorus(points[j]);
+        for (int k = 0; k < ncurves; ++k) {
+            int idx = rdfs[k]->ToIndex(dist);
+            if (0 <= idx && idx < rdfs[k]->size())
+                bins[k][idx]++;
+        }
+    }
+}
+
+// Bins the pairs of the points i in [begin, end) with their neighbours j > i
+// and adds them to bins
+static void BinBlock(const Point *points, int npoints, const CellGrid &grid,
+                     int begin, int end, const std::vector<Curve *> &rdfs,
+                     std::vector<std::vector<unsigned long> > &bins)
+{
+    const int ncurves = rdfs.size(), m = grid.m;
+    std::vector<std::vector<unsigned long> > local(ncurves);
+    for (int k = 0; k < ncurves; ++k)
+        local[k].assign(rdfs[k]->size(), 0);
+    for (int i = begin; i < end; ++i) {
+        // A single cell holds the points in their original order
+        if (m == 1) {
+            BinCell(points[i], points, grid.order, i + 1, npoints, i, rdfs,
+                    local);
+            continue;
+        }
+        const int cx = grid.cell[i] % m, cy = grid.cell[i] / m;
+        for (int dy = -1; dy <= 1; ++dy)
+            for (int dx = -1; dx <= 1; ++dx) {
+                int c = (cx + dx + m) % m + ((cy + dy + m) % m) * m;
+                BinCell(points[i], points, grid.order, grid.start[c],
+                        grid.start[c+1], i, rdfs, local);
+            }
+    }
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+    for (int k = 0; k < ncurves; ++k)
+        for (size_t b = 0; b < local[k].size(); ++b)
+            bins[k][b] += local[k][b];
+}
+
+// Same bins as RDF(), but only pairs in neighbouring cells of a grid at least
+// as coarse as the largest curve range are visited
+void PointSet::RDFCellList(const Point *points, int npoints,
+                           const std::vector<Curve *> &rdfs)
+{
+    Profile::Count(CounterPairs, 0.5 * npoints * (npoints - 1.0));
+    const int ncurves = rdfs.size();
+    std::vector<std::vector<unsigned long> > bins(ncurves);
+    for (int k = 0; k < ncurves; ++k)
+        bins[k].assign(rdfs[k]->size(), 0);
+    BinPairs(points, npoints, npoints, rdfs, bins);
+    NormalizeRDF(npoints, bins, rdfs);
+}
+
+// The first points are binned in blocks that are spread across threads
+static float LargestRange(const std::vector<Curve *> &rdfs)
+{
+    float range = 0.f;
+    for (size_t k = 0; k < rdfs.size(); ++k)
+        range = std::max(range, rdfs[k]->x0 + rdfs[k]->size() * rdfs[k]->dx);
+    return range;
+}
+
+void PointSet::BinPairs(const Point *points, int npoints, int nfirst,
+                        const std::vector<Curve *> &rdfs,
+                        std::vector<std::vector<unsigned long> > &bins)
+{
+    const float range = LargestRange(rdfs);
+    CellGrid grid;
+    grid.Build(points, npoints, range);
+    
+    const int nblocks = std::min(nfirst, 64);
+#if defined(_OPENMP) && _OPENMP >= 201511
+    if (omp_in_parallel()) {
+#pragma omp taskloop grainsize(1) shared(grid, bins)
+        for (int b = 0; b < nblocks; ++b)
+            BinBlock(points, npoints, grid, (long) b * nfirst / nblocks,
+                     (long) (b + 1) * nfirst / nblocks, rdfs, bins);
+        return;
+    }
+#endif
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int b = 0; b < nblocks; ++b)
+        BinBlock(points, npoints, grid, (long) b * nfirst / nblocks,
+                 (long) (b + 1) * nfirst / nblocks, rdfs, bins);
+}
+
+// Bins the pairs of the points a[begin, end) with their neighbours in b,
+// which are sorted into grid, and adds them to bins
+static void BinCrossBlock(const Point *a, int begin, int end, const Point *b,
+                          int nb, const CellGrid &grid,
+                          const std::vector<Curve *> &rdfs,
+                          std::vector<std::vector<unsigned long> > &bins)
+{
+    const int ncurves = rdfs.size(), m = grid.m;
+    std::vector<std::vector<unsigned long> > local(ncurves);
+    for (int k = 0; k < ncurves; ++k)
+        local[k].assign(rdfs[k]->size(), 0);
+    for (int i = begin; i < end; ++i) {
+        if (m == 1) {
+            BinCell(a[i], b, grid.order, 0, nb, -1, rdfs, local);
+            continue;
+        }
+        const int cell = grid.Cell(a[i]), cx = cell % m, cy = cell / m;
+        for (int dy = -1; dy <= 1; ++dy)
+            for (int dx = -1; dx <= 1; ++dx) {
+                int c = (cx + dx + m) % m + ((cy + dy + m) % m) * m;
+                BinCell(a[i], b, grid.order, grid.start[c], grid.start[c+1],
+                        -1, rdfs, local);
+            }
+    }
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+    for (int k = 0; k < ncurves; ++k)
+        for (size_t n = 0; n < local[k].size(); ++n)
+            bins[k][n] += local[k][n];
+}
+
+void PointSet::BinCrossPairs(const Point *a, int na, const Point *b, int nb,
+                             const std::vector<Curve *> &rdfs,
+                             std::vector<std::vector<unsigned long> > &bins)
+{
+    CellGrid grid;
+    grid.Build(b, nb, LargestRange(rdfs));
+    
+    const int nblocks = std::min(na, 64);
+#if defined(_OPENMP) && _OPENMP >= 201511
+    if (omp_in_parallel()) {
+#pragma omp taskloop grainsize(1) shared(grid, bins)
+        for (int n = 0; n < nblocks; ++n)
+            BinCrossBlock(a, (long) n * na / nblocks,
+                          (long) (n + 1) * na / nblocks, b, nb, grid, rdfs,
+                          bins);
+        return;
+    }
+#endif
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int n = 0; n < nblocks; ++n)
+        BinCrossBlock(a, (long) n * na / nblocks,
+                      (long) (n + 1) * na / nblocks, b, nb, grid, rdfs, bins);
+}
+
+static bool Fail(std::string *error, const std::string &msg)
+{
+    if (error) *error = msg;
+    return false;
 }
 
 PointSet PointSet::Load(const std::string &fname)
 {
     PointSet set;
-    unsigned int npoints = 0;
+    std::string error;
+    if (!Load(fname, &set, &error)) {
+        std::cerr << error << "\n";
+        exit(1);
+    }
+    return set;
+}
 
-    if (HasSuffix(fname, ".txt")) {
-        std::ifstream fp(fname.c_str());
-        if (!fp) {
-            std::cerr << "Cannot load '" << fname << "'.\n";
-            exit(1);
+bool PointSet::Load(const std::string &fname, PointSet *set,
+                    std::string *error)
+{
+    unsigned int npoints = 0;
+    std::string container;
+    int index;
+    
+    set->points.clear();
+    if (SplitEntry(fname, &container, &index) || IsContainer(fname)) {
+        if (IsContainer(fname)) {
+            container = fname;
+            index = 0;
         }
+        PointSetContainer c;
+        if (!c.Open(container))
+            return Fail(error, "Cannot load '" + container + "'.");
+        // A whole container is a single set only if it holds just one
+        if (IsContainer(fname) && c.NumSets() != 1) {
+            std::ostringstream oss;
+            oss << "'" << container << "' holds " << c.NumSets()
+                << " point sets; load one as '" << container << ":index'.";
+            return Fail(error, oss.str());
+        }
+        if (!c.Read(index, set))
+            return Fail(error, "Cannot load '" +
+                             EntryName(container, index) + "'.");
+    } else if (HasSuffix(fname, ".txt")) {
+        std::ifstream fp(fname.c_str());
+        if (!fp)
+            return Fail(error, "Cannot load '" + fname + "'.");
         fp >> npoints;
-        set.points.reserve(npoints);
+        set->points.reserve(npoints);
         Point p;
-        while (set.points.size() < npoints && (fp >> p.x >> p.y))
-            set.points.push_back(p);
+        while (set->points.size() < npoints && (fp >> p.x >> p.y))
+            set->points.push_back(p);
         fp.close();
     } else if (HasSuffix(fname, ".rps")) {
         FILE *fp = fopen(fname.c_str(), "rb");
-        if (!fp) {
-            std::cerr << "Cannot load '" << fname << "'.\n";
-            exit(1);
-        }
+        if (!fp)
+            return Fail(error, "Cannot load '" + fname + "'.");
         fseek(fp, 0, SEEK_END);
         npoints = ftell(fp) / (2 * sizeof(float));
-        set.points.resize(npoints);
+        set->points.resize(npoints);
         fseek(fp, 0, SEEK_SET);
-        ReadFloats(fp, &set.points[0].x, npoints*2, LittleEndian);
+        ReadFloats(fp, &set->points[0].x, npoints*2, LittleEndian);
         fclose(fp);
+    } else if (HasSuffix(fname, ".qps")) {
+        FILE *fp = fopen(fname.c_str(), "rb");
+        if (!fp)
+            return Fail(error, "Cannot load '" + fname + "'.");
+        long size = -1;
+        if (fseek(fp, 0, SEEK_END) == 0)
+            size = ftell(fp);
+        bool ok = size > 0 && fseek(fp, 0, SEEK_SET) == 0;
+        std::vector<uint8_t> data(ok ? size : 0);
+        ok = ok && fread(&data[0], 1, data.size(), fp) == data.size() &&
+             DecodeQPS(&data[0], data.size(), set);
+        fclose(fp);
+        if (!ok)
+            return Fail(error, "Corrupt QPS file '" + fname + "'.");
     } else if (HasSuffix(fname, ".eps")) {
         std::ifstream fp(fname.c_str());
-        if (!fp) {
-            std::cerr << "Cannot load '" << fname << "'.\n";
-            exit(1);
-        }
+        if (!fp)
+            return Fail(error, "Cannot load '" + fname + "'.");
         while (fp.good()) {
             std::string line;
             getline(fp, line);
@@ -162,47 +488,54 @@ PointSet PointSet::Load(const std::string &fname)
                 std::istringstream iss(tokens[i]);
                 iss >> p[i];
             }
-            set.points.push_back(p);
+            set->points.push_back(p);
         }
         fp.close();
     } else {
-        std::cerr << "No .txt, .rps, or compatible .eps file '" << fname << "'.\n";
-        exit(1);
+        return Fail(error, "No .txt, .rps, .mps, .qps, or compatible .eps file '" + fname + "'.");
     }
     
-    return set;
+    return true;
+}
+
+void PointSet::Save(const std::string &fname, int qbits)
+{
+    std::string error;
+    if (!Save(fname, qbits, &error)) {
+        std::cerr << error << "\n";
+        exit(1);
+    }
 }
 
-void PointSet::Save(const std::string &fname)
+bool PointSet::Save(const std::string &fname, int qbits, std::string *error)
 {
+    const std::string cannot = "Cannot create '" + fname + "'.";
     if (HasSuffix(fname, ".txt")) {
         std::ofstream os(fname.c_str());
-        if (!os) {
-            std::cerr << "Cannot create '" << fname << "'.\n";
-            exit(1);
-        }
+        if (!os)
+            return Fail(error, cannot);
         os << points.size() << "\n";
         for (unsigned int i = 0; i < points.size(); ++i)
             os << points[i] << "\n";
         os.close();
+        if (!os)
+            return Fail(error, cannot);
     } else if (HasSuffix(fname, ".rps")) {
         FILE *fp = fopen(fname.c_str(), "wb");
-        if (!fp) {
-            std::cerr << "Cannot create '" << fname << "'.\n";
-            exit(1);
-        }
-        WriteFloats(fp, &points[0].x, points.size() * 2, LittleEndian);
-        fclose(fp);
+        if (!fp)
+            return Fail(error, cannot);
+        bool ok = points.empty() ||
+            WriteFloats(fp, &points[0].x, points.size() * 2, LittleEndian);
+        if (fclose(fp) != 0 || !ok)
+            return Fail(error, cannot);
     } else if (HasSuffix(fname, ".eps")) {
         double radius = 3.0, scale = 512.0;
         const Point BB[2] = {
             Point(-radius, -radius), Point(scale + radius, scale + radius)
         };
         std::ofstream os(fname.c_str());
-        if (!os) {
-            std::cerr << "Cannot create '" << fname << "'.\n";
-            exit(1);
-        }
+        if (!os)
+            return Fail(error, cannot);
         os << "%!PS-Adobe-3.1 EPSF-3.0\n";
         os << "%%HiResBoundingBox: " << BB[0] << " " << BB[1] << "\n";
         os << "%%BoundingBox: " << BB[0] << " " << BB[1] << "\n";
@@ -215,7 +548,330 @@ void PointSet::Save(const std::string &fname)
             os << points[i] << " p\n";
         os << "grestore\n";
         os.close();
+        if (!os)
+            return Fail(error, cannot);
+    } else if (HasSuffix(fname, ".qps")) {
+        std::vector<uint8_t> data;
+        if (qbits < QPSMinBits || qbits > QPSMaxBits) {
+            std::ostringstream msg;
+            msg << "Cannot quantize to " << qbits << " bits.";
+            return Fail(error, msg.str());
+        }
+        if (!EncodeQPS(*this, qbits, &data))
+            return Fail(error, "Cannot save '" + fname + "': QPS points must "
+                               "lie in the unit square.");
+        FILE *fp = fopen(fname.c_str(), "wb");
+        bool ok = fp && fwrite(&data[0], 1, data.size(), fp) == data.size();
+        if (fp && fclose(fp) != 0)
+            ok = false;
+        if (!ok)
+            return Fail(error, cannot);
+    } else if (HasSuffix(fname, ".mps")) {
+        PointSetContainer c;
+        if (!c.Create(fname, 1) || !c.Append(*this) || !c.Close())
+            return Fail(error, cannot);
     } else
-        std::cerr << "Extension not supported for '" << fname << "'.\n";
+        return Fail(error, "Extension not supported for '" + fname + "'.");
+    return true;
+}
+
+// Frames are read in pieces of points, so that a corrupt count fails at the
+// end of the input instead of allocating memory for all the points it claims
+static const uint32_t FramePiece = 1 << 16;
+
+bool PointSet::ReadFrame(FILE *fp, bool rps, PointSet *set)
+{
+    set->points.clear();
+    if (rps) {
+        uint32_t npoints;
+        if (!ReadValues(fp, &npoints, 1, LittleEndian))
+            return false;
+        for (uint64_t first = 0; first < npoints; first += FramePiece) {
+            const int n = (int) std::min<uint64_t>(FramePiece, npoints - first);
+            set->points.resize(first + n);
+            if (!ReadFloats(fp, &set->points[first].x, 2 * n, LittleEndian))
+                return false;
+        }
+        return true;
+    }
+    unsigned int npoints;
+    if (fscanf(fp, "%u", &npoints) != 1)
+        return false;
+    set->points.reserve(std::min(npoints, FramePiece));
+    Point p;
+    for (unsigned int i = 0; i < npoints; ++i) {
+        if (fscanf(fp, "%f %f", &p.x, &p.y) != 2)
+            return false;
+        set->points.push_back(p);
+    }
+    return true;
+}
+
+bool PointSet::IsContainer(const std::string &fname)
+{
+    return HasSuffix(fname, ".mps");
+}
+
+bool PointSet::SplitEntry(const std::string &entry, std::string *fname,
+                          int *index)
+{
+    size_t colon = entry.find_last_of(':');
+    if (colon == std::string::npos || colon + 1 == entry.size())
+        return false;
+    if (!IsContainer(entry.substr(0, colon)))
+        return false;
+    for (size_t i = colon + 1; i < entry.size(); ++i)
+        if (!isdigit(entry[i]))
+            return false;
+    *fname = entry.substr(0, colon);
+    *index = atoi(entry.c_str() + colon + 1);
+    return true;
+}
+
+std::string PointSet::EntryName(const std::string &fname, int index)
+{
+    std::ostringstream oss;
+    oss << fname << ":" << index;
+    return oss.str();
+}
+
+
+PointSetContainer::PointSetContainer()
+    : fp(NULL), writing(false), dbl(false), next(0)
+{
+}
+
+bool PointSetContainer::Open(const std::string &fname)
+{
+    Close();
+    fp = fopen(fname.c_str(), "rb");
+    if (!fp)
+        return false;
+    setvbuf(fp, NULL, _IOFBF, 1 << 20);
+    
+    char magic[4];
+    uint32_t header[3];
+    if (fread(magic, 1, 4, fp) != 4 || memcmp(magic, MPSMagic, 4) != 0 ||
+        !ReadValues(fp, header, 3, LittleEndian) || header[0] != MPSVersion) {
+        fclose(fp);
+        fp = NULL;
+        return false;
+    }
+    dbl = (header[1] & MPSDouble) != 0;
+    
+    // The index and every set must lie within the file, so that a corrupt
+    // header cannot ask for more memory than the file could fill
+    const uint64_t size = FileSize(fp);
+    const uint64_t nsets = header[2];
+    const uint64_t datastart =
+        MPSHeaderSize + nsets * (sizeof(uint32_t) + sizeof(uint64_t));
+    const uint64_t valsize = dbl ? sizeof(double) : sizeof(float);
+    bool ok = datastart <= size && nsets <= INT_MAX;
+    if (ok) {
+        counts.resize(nsets);
+        offsets.resize(nsets);
+        ok = nsets == 0 ||
+             (ReadValues(fp, &counts[0], nsets, LittleEndian) &&
+              ReadValues(fp, &offsets[0], nsets, LittleEndian));
+    }
+    for (uint64_t i = 0; ok && i < nsets; ++i)
+        ok = counts[i] <= INT_MAX / 2 && offsets[i] >= datastart &&
+             offsets[i] <= size &&
+             2 * counts[i] * valsize <= size - offsets[i];
+    if (!ok) {
+        Close();
+        return false;
+    }
+    next = 0;
+    return true;
 }
 
+bool PointSetContainer::Create(const std::string &fname, int nsets, bool dbl)
+{
+    Close();
+    fp = fopen(fname.c_str(), "wb");
+    if (!fp)
+        return false;
+    setvbuf(fp, NULL, _IOFBF, 1 << 20);
+    writing = true;
+    this->dbl = dbl;
+    counts.assign(nsets, 0);
+    offsets.assign(nsets, 0);
+    next = 0;
+    
+    // The index is written on Close(), once all set sizes are known
+    uint32_t header[3] = { MPSVersion, dbl ? MPSDouble : 0, (uint32_t) nsets };
+    return fwrite(MPSMagic, 1, 4, fp) == 4 &&
+           WriteValues(fp, header, 3, LittleEndian) &&
+           (nsets == 0 || (WriteValues(fp, &counts[0], nsets, LittleEndian) &&
+                           WriteValues(fp, &offsets[0], nsets, LittleEndian)));
+}
+
+bool PointSetContainer::Close()
+{
+    if (!fp)
+        return true;
+    bool ok = true;
+    if (writing) {
+        const int nsets = NumSets();
+        ok = next == nsets;
+        if (ok && nsets > 0) {
+            ok = Seek64(fp, MPSHeaderSize) == 0 &&
+                 WriteValues(fp, &counts[0], nsets, LittleEndian) &&
+                 WriteValues(fp, &offsets[0], nsets, LittleEndian);
+        }
+    }
+    ok = (fclose(fp) == 0) && ok;
+    fp = NULL;
+    writing = false;
+    counts.clear();
+    offsets.clear();
+    next = 0;
+    return ok;
+}
+
+bool PointSetContainer::ReadData(int i, PointSet *set, bool sequential)
+{
+    // Open() bounds the counts, so that n also fits the int of the readers
+    const size_t n = 2 * (size_t) counts[i];
+    set->points.resize(counts[i]);
+    if (n == 0)
+        return true;
+    if (dbl) {
+        std::vector<double> buf(n);
+        if (sequential) {
+            if (!ReadValues(fp, &buf[0], n, LittleEndian))
+                return false;
+        } else {
+            if (!ReadAt(fp, offsets[i], &buf[0], n * sizeof(double)))
+                return false;
+            if (SystemEndianness() != LittleEndian)
+                SwapEndian(&buf[0], n);
+        }
+        for (int j = 0; j < (int) counts[i]; ++j)
+            set->points[j] = Point(buf[2*j], buf[2*j+1]);
+    } else {
+        float *p = &set->points[0].x;
+        if (sequential)
+            return ReadFloats(fp, p, n, LittleEndian);
+        if (!ReadAt(fp, offsets[i], p, n * sizeof(float)))
+            return false;
+        if (SystemEndianness() != LittleEndian)
+            SwapEndian(p, n);
+    }
+    return true;
+}
+
+bool PointSetContainer::Read(int i, PointSet *set)
+{
+    assert(fp && !writing);
+    if (i < 0 || i >= NumSets())
+        return false;
+    return ReadData(i, set, false);
+}
+
+bool PointSetContainer::ReadNext(PointSet *set)
+{
+    assert(fp && !writing);
+    if (next >= NumSets())
+        return false;
+    // Sets are normally stored back to back, so the seek is a no-op for
+    // consecutive calls and does not flush the read buffer
+    if (next == 0 || offsets[next] != offsets[next-1] +
+        2 * counts[next-1] * (dbl ? sizeof(double) : sizeof(float))) {
+        if (Seek64(fp, offsets[next]) != 0)
+            return false;
+    }
+    return ReadData(next++, set, true);
+}
+
+bool PointSetContainer::Append(const PointSet &set)
+{
+    assert(fp && writing);
+    if (next >= NumSets())
+        return false;
+    if (next == 0)
+        offsets[0] = MPSHeaderSize + NumSets() * (sizeof(uint32_t) + sizeof(uint64_t));
+    else
+        offsets[next] = offsets[next-1] +
+            2 * counts[next-1] * (dbl ? sizeof(double) : sizeof(float));
+    counts[next] = set.size();
+    ++next;
+    
+    const int n = 2 * set.size();
+    if (n == 0)
+        return true;
+    if (dbl) {
+        std::vector<double> buf(&set.points[0].x, &set.points[0].x + n);
+        return WriteValues(fp, &buf[0], n, LittleEndian);
+    }
+    return WriteFloats(fp, &set.points[0].x, n, LittleEndian);
+}
+
+
+
+bool PointBlockReader::Open(const std::string &fname)
+{
+    Close();
+    std::string container;
+    int index = 0;
+    if (PointSet::SplitEntry(fname, &container, &index) || PointSet::IsContainer(fname)) {
+        if (container.empty())
+            container = fname;
+        PointSetContainer c;
+        if (!c.Open(container) || index < 0 || index >= c.NumSets())
+            return false;
+        npoints = c.NumPoints(index);
+        offset = c.Offset(index);
+        dbl = c.IsDouble();
+    } else if (HasSuffix(fname, ".rps")) {
+        offset = 0;
+        dbl = false;
+    } else {
+        return false;
+    }
+    fp = fopen(container.empty() ? fname.c_str() : container.c_str(), "rb");
+    if (!fp)
+        return false;
+    if (container.empty()) {
+        if (fseek(fp, 0, SEEK_END) != 0) {
+            Close();
+            return false;
+        }
+        npoints = ftell(fp) / (2 * sizeof(float));
+    }
+    return true;
+}
+
+void PointBlockReader::Close()
+{
+    if (fp)
+        fclose(fp);
+    fp = NULL;
+    npoints = 0;
+}
+
+bool PointBlockReader::Read(long first, int n, Point *points)
+{
+    if (!fp || first < 0 || first + n > npoints)
+        return false;
+    if (n == 0)
+        return true;
+    if (dbl) {
+        std::vector<double> buf(2 * n);
+        if (!ReadAt(fp, offset + first * 2 * sizeof(double), &buf[0],
+                    buf.size() * sizeof(double)))
+            return false;
+        if (SystemEndianness() != LittleEndian)
+            SwapEndian(&buf[0], 2 * n);
+        for (int i = 0; i < n; ++i)
+            points[i] = Point(buf[2*i], buf[2*i+1]);
+        return true;
+    }
+    if (!ReadAt(fp, offset + first * 2 * sizeof(float), points,
+                n * 2 * sizeof(float)))
+        return false;
+    if (SystemEndianness() != LittleEndian)
+        SwapEndian(&points[0].x, 2 * n);
+    return true;
+}
@@ -25,9 +25,11 @@
 #include "curve.h"
 #include <algorithm>
 #include <cmath>
+#include <cstdio>
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <stdint.h>
 #include <vector>
 
 
@@ -149,10 +151,139 @@ public:
     
     int size() const { return (int) points.size(); }
     void RDF(Curve *rdf) const;
+    void RDF(const std::vector<Curve *> &rdfs) const;
+    static void RDF(const Point *points, int npoints,
+                    const std::vector<Curve *> &rdfs);
+    static void RDFCellList(const Point *points, int npoints,
+                            const std::vector<Curve *> &rdfs);
+    // Adds the pairs of each of the first nfirst points with all later ones
+    // that are closer than the largest curve range to the counts of bins
+    static void BinPairs(const Point *points, int npoints, int nfirst,
+                         const std::vector<Curve *> &rdfs,
+                         std::vector<std::vector<unsigned long> > &bins);
+    // Adds the pairs of each point of a with each point of b that are closer
+    // than the largest curve range to the counts of bins
+    static void BinCrossPairs(const Point *a, int na, const Point *b, int nb,
+                              const std::vector<Curve *> &rdfs,
+                              std::vector<std::vector<unsigned long> > &bins);
     
+    // Load() and Save() without an error argument report errors and exit;
+    // the other variants return false and describe the error instead
     static PointSet Load(const std::string &fname);
-    void Save(const std::string &fname);
+    static bool Load(const std::string &fname, PointSet *set,
+                     std::string *error);
+    void Save(const std::string &fname, int qbits = 24);
+    bool Save(const std::string &fname, int qbits, std::string *error);
     void SaveEPS(const std::string &fname);
+    
+    // Reads the next set of a multi-set stream, either a TXT block (a point
+    // count followed by as many coordinate pairs) or an RPS frame (uint32
+    // point count followed by the raw coordinates)
+    static bool ReadFrame(FILE *fp, bool rps, PointSet *set);
+    
+    // Entries of MPS containers are addressed as 'file.mps:index'
+    static bool IsContainer(const std::string &fname);
+    static bool SplitEntry(const std::string &entry, std::string *fname,
+                           int *index);
+    static std::string EntryName(const std::string &fname, int index);
+};
+
+
+// Points sorted into the cells of an m x m grid over the unit torus. Cells
+// are at least range wide, so closer pairs lie in neighbouring cells; with
+// fewer than three cells per side there is a single cell. The points of
+// cell c are order[start[c]] to order[start[c+1] - 1].
+struct CellGrid {
+    int m;
+    std::vector<int> cell, start, order;
+    
+    void Build(const Point *points, int npoints, float range);
+    int Cell(const Point &p) const {
+        int cx = std::max(0, std::min(m - 1, (int) (p.x * m)));
+        int cy = std::max(0, std::min(m - 1, (int) (p.y * m)));
+        return cx + cy * m;
+    }
+};
+
+// Converts counts of pairs per bin of each curve into RDFs
+void NormalizeRDF(int npoints,
+                  const std::vector<std::vector<unsigned long> > &bins,
+                  const std::vector<Curve *> &rdfs);
+
+
+// Many point sets in a single file. Sets can be streamed sequentially with
+// ReadNext() or fetched by index with Read(), which may be called from
+// several threads at once. The MPS layout is (all little endian)
+//
+//   char    magic[4]        "PSAM"
+//   uint32  version         1
+//   uint32  flags           bit 0: coordinates are stored as float64
+//   uint32  nsets
+//   uint32  counts[nsets]   number of points in each set
+//   uint64  offsets[nsets]  file offset of the coordinates of each set
+//   ...                     interleaved x/y coordinates
+class PointSetContainer
+{
+private:
+    FILE *fp;
+    bool writing;
+    bool dbl;
+    int next;
+    std::vector<uint32_t> counts;
+    std::vector<uint64_t> offsets;
+    
+    PointSetContainer(const PointSetContainer &);
+    PointSetContainer& operator= (const PointSetContainer &);
+    bool ReadData(int i, PointSet *set, bool sequential);
+    
+public:
+    PointSetContainer();
+    ~PointSetContainer() { Close(); }
+    
+    bool Open(const std::string &fname);
+    bool Create(const std::string &fname, int nsets, bool dbl = false);
+    bool Close();
+    
+    bool IsOpen() const { return fp != NULL; }
+    int NumSets() const { return (int) counts.size(); }
+    int NumPoints(int i) const { return (int) counts[i]; }
+    int Next() const { return next; }
+    
+    bool Read(int i, PointSet *set);
+    bool ReadNext(PointSet *set);
+    bool Append(const PointSet &set);
+    
+    // Offset of the coordinates of a set and whether they are float64
+    uint64_t Offset(int i) const { return offsets[i]; }
+    bool IsDouble() const { return dbl; }
+};
+
+
+// Reads the points of an RPS file or of a set in an MPS container in blocks,
+// for sets that are too large to be loaded as a whole. Blocks may be read
+// from several threads at once.
+class PointBlockReader
+{
+private:
+    FILE *fp;
+    bool dbl;
+    uint64_t offset;
+    long npoints;
+    
+    PointBlockReader(const PointBlockReader &);
+    PointBlockReader& operator= (const PointBlockReader &);
+    
+public:
+    PointBlockReader() : fp(NULL), dbl(false), offset(0), npoints(0) {}
+    ~PointBlockReader() { Close(); }
+    
+    // Opens 'file.rps', 'file.mps:index' or the first set of 'file.mps'
+    bool Open(const std::string &fname);
+    void Close();
+    
+    long NumPoints() const { return npoints; }
+    // Reads the points first to first+n-1
+    bool Read(long first, int n, Point *points);
 };
 
 #endif    // POINT_H
@@ -0,0 +1,178 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "polar.h"
+#include "profile.h"
+#include "util.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
+#include <utility>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+// Frequencies w of the half plane, each of which stands for w and -w
+static inline bool HalfPlane(int x, int y)
+{
+    return y > 0 || (y == 0 && x > 0);
+}
+
+int PolarSpectrum::Ring(int x, int y) const
+{
+    // Same rounding as Periodogram::RadialPower
+    float r = sqrtf(x*x + y*y);
+    int i = layout.ToIndex(r);
+    return (i < layout.size()) ? i : -1;
+}
+
+PolarSpectrum::PolarSpectrum(const Curve &layout, int maxangles,
+                             unsigned int seed)
+    : layout(layout), maxangles(std::max(maxangles, 1))
+{
+    const int nrings = layout.size();
+    const int extent = (int) ceilf(layout.x0 + nrings * layout.dx) + 1;
+    std::vector<int> counts(nrings, 0);
+    for (int y = 0; y <= extent; ++y)
+        for (int x = -extent; x <= extent; ++x) {
+            int i = HalfPlane(x, y) ? Ring(x, y) : -1;
+            if (i >= 0)
+                counts[i]++;
+        }
+    
+    // Rings that are small enough are taken as a whole, the others sampled
+    std::vector<std::vector<std::pair<int, int> > > rings(nrings);
+    if (Ring(0, 0) >= 0)
+        rings[Ring(0, 0)].push_back(std::make_pair(0, 0));
+    for (int y = 0; y <= extent; ++y)
+        for (int x = -extent; x <= extent; ++x) {
+            int i = HalfPlane(x, y) ? Ring(x, y) : -1;
+            if (i >= 0 && counts[i] <= this->maxangles)
+                rings[i].push_back(std::make_pair(x, y));
+        }
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    const int tries = 32;
+    for (int i = 0; i < nrings; ++i) {
+        if (counts[i] <= this->maxangles)
+            continue;
+        const float lo = layout.ToX(i), hi = lo + layout.dx;
+        std::set<std::pair<int, int> > taken;
+        for (int j = 0; j < this->maxangles; ++j) {
+            for (int t = 0; t < tries; ++t) {
+                // Uniform over the area of the sector
+                float theta = PI * (j + u(rng)) / this->maxangles;
+                float r = sqrtf(lo*lo + u(rng) * (hi*hi - lo*lo));
+                int x = (int) lroundf(r * cosf(theta));
+                int y = (int) lroundf(r * sinf(theta));
+                std::pair<int, int> w(x, y);
+                if (!HalfPlane(x, y) || Ring(x, y) != i || taken.count(w))
+                    continue;
+                taken.insert(w);
+                rings[i].push_back(w);
+                break;
+            }
+        }
+    }
+    
+    start.assign(1, 0);
+    for (int i = 0; i < nrings; ++i) {
+        for (size_t k = 0; k < rings[i].size(); ++k) {
+            kx.push_back(rings[i][k].first);
+            ky.push_back(rings[i][k].second);
+        }
+        start.push_back(kx.size());
+    }
+}
+
+bool PolarSpectrum::Matches(const Curve &layout, int maxangles) const
+{
+    return this->layout.size() == layout.size() &&
+           this->layout.x0 == layout.x0 && this->layout.x1 == layout.x1 &&
+           this->maxangles == std::max(maxangles, 1);
+}
+
+// Periodogram at frequency (wx, wy), with the terms of the direct FT
+static inline float Power(const Point *points, int npoints, float wx,
+                          float wy, float inv)
+{
+    float fx = 0.f, fy = 0.f;
+    for (int i = 0; i < npoints; ++i) {
+        float exp = -TWOPI * (wx * points[i].x + wy * points[i].y);
+        fx += cosf(exp);
+        fy += sinf(exp);
+    }
+    return (fx*fx + fy*fy) * inv;
+}
+
+void PolarSpectrum::Compute(const Point *points, int npoints, Curve *rp,
+                            Curve *ani) const
+{
+    const int nfreqs = NumFrequencies();
+    const float inv = 1.f / npoints;
+    Profile::Count(CounterFrequencies, nfreqs);
+    Profile::Count(CounterTerms, (double) nfreqs * npoints);
+    std::vector<float> power(nfreqs);
+    float *p = nfreqs > 0 ? &power[0] : NULL;
+    const int *x = nfreqs > 0 ? &kx[0] : NULL, *y = nfreqs > 0 ? &ky[0] : NULL;
+#if defined(_OPENMP) && _OPENMP >= 201511
+    if (omp_in_parallel()) {
+#pragma omp taskloop grainsize(16)
+        for (int f = 0; f < nfreqs; ++f)
+            p[f] = Power(points, npoints, x[f], y[f], inv);
+    } else
+#endif
+    {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 16)
+#endif
+        for (int f = 0; f < nfreqs; ++f)
+            p[f] = Power(points, npoints, x[f], y[f], inv);
+    }
+    
+    // Weighted as on the grid, where every frequency but 0 appears twice;
+    // normalized as in Periodogram::RadialPower and Anisotropy
+    *rp = Curve(layout.size(), layout.x0, layout.x1);
+    if (ani)
+        *ani = Curve(layout.size(), layout.x0, layout.x1);
+    for (int i = 0; i < layout.size(); ++i) {
+        double n = 0., sum = 0., m2 = 0.;
+        for (int f = start[i]; f < start[i+1]; ++f) {
+            double w = (kx[f] == 0 && ky[f] == 0) ? 1. : 2.;
+            n += w;
+            sum += w * power[f];
+        }
+        const float mean = (n > 0.) ? sum / n : 0.;
+        (*rp)[i] = mean;
+        if (!ani)
+            continue;
+        for (int f = start[i]; f < start[i+1]; ++f) {
+            double w = (kx[f] == 0 && ky[f] == 0) ? 1. : 2.;
+            m2 += w * (power[f] - mean) * (power[f] - mean);
+        }
+        float var = (n > 1.) ? m2 / (n - 1.) : 0.f;
+        float sqpow = mean * mean;
+        (*ani)[i] = Decibel((sqpow > 0) ? var / sqpow : 1);
+    }
+}
@@ -0,0 +1,65 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef POLAR_H
+#define POLAR_H
+
+#include "curve.h"
+#include "point.h"
+#include <vector>
+
+// Radial power and anisotropy from the power at a sample of the frequencies
+// in each ring instead of the full grid, for when no spectrum image is
+// needed. Only integer frequencies are sampled, since the spectrum of a set
+// on the unit torus is only defined there; elsewhere the edges of the unit
+// square leak into it. Rings with at most maxangles frequencies in the half
+// plane are taken as a whole, which gives the same curves as the grid. The
+// larger rings get maxangles frequencies, one in each of as many angular
+// sectors of the half plane, at a jittered orientation and radius. The
+// power at -w equals that at w, so each frequency of the half plane also
+// counts for its mirror image.
+//
+// The cost is O(N nbins maxangles) instead of O(N size^2). The sample only
+// depends on the rings and the seed, so objects are best reused for sets of
+// the same size.
+class PolarSpectrum
+{
+public:
+    PolarSpectrum(const Curve &layout, int maxangles, unsigned int seed = 1);
+    
+    int NumFrequencies() const { return (int) kx.size(); }
+    bool Matches(const Curve &layout, int maxangles) const;
+    
+    // RP and ANI (which may be NULL) with the rings of the layout, of the
+    // periodogram divided by npoints as in PsaResult
+    void Compute(const Point *points, int npoints, Curve *rp,
+                 Curve *ani) const;
+
+private:
+    Curve layout;
+    int maxangles;
+    std::vector<int> kx, ky;     // frequencies, ring by ring
+    std::vector<int> start;      // ring i is start[i] to start[i+1] - 1
+    
+    int Ring(int x, int y) const;
+};
+
+#endif  // POLAR_H
@@ -0,0 +1,381 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "profile.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <vector>
+#if !defined(_WIN32) && !defined(_WIN64) && !defined(_MSC_VER)
+#include <sys/resource.h>
+#endif
+#ifdef __linux__
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+namespace {
+
+struct Span {
+    const char *name;
+    double begin, end;
+    uint64_t events[NumEvents];
+};
+
+// The name and spans are guarded by lock, as Write() may read them while
+// the thread records
+struct ThreadLog {
+    int tid;
+    std::string name;
+    std::vector<Span> spans;
+    int fds[NumEvents];
+    std::mutex lock;
+};
+
+struct MemorySample {
+    double time;
+    long kb;
+};
+
+struct StageTotal {
+    int count;
+    double time;
+    uint64_t events[NumEvents];
+};
+
+std::chrono::steady_clock::time_point start;
+std::atomic<double> counters[NumCounters];
+std::mutex mutex;
+std::vector<ThreadLog *> logs;      // kept until Stop(), threads may end earlier
+std::vector<MemorySample> memory;
+thread_local ThreadLog *threadlog = NULL;
+// Logs of earlier generations were freed by Stop()
+std::atomic<int> generation(0);
+thread_local int threadgeneration = -1;
+
+// Events are only recorded if they could be opened on the first thread
+bool useevents = false;
+bool available[NumEvents];
+std::string eventerror;
+
+const char *CounterNames[NumCounters] = {
+    "sets", "pairs", "frequencies", "terms"
+};
+
+const char *EventNames[NumEvents] = {
+    "cycles", "instructions", "cache_references", "cache_misses",
+    "branches", "branch_misses", "task_clock_ns"
+};
+
+#ifdef __linux__
+const uint32_t EventTypes[NumEvents] = {
+    PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+    PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+    PERF_TYPE_SOFTWARE
+};
+const uint64_t EventConfigs[NumEvents] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_REFERENCES, PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES,
+    PERF_COUNT_SW_TASK_CLOCK
+};
+
+// Counts the calling thread only, in user space, on any CPU
+int OpenEvent(int e)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = EventTypes[e];
+    attr.config = EventConfigs[e];
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+// Scaled up if the kernel had to multiplex the counters
+uint64_t ReadEvent(int fd)
+{
+    uint64_t v[3];
+    if (fd < 0 || read(fd, v, sizeof(v)) != (ssize_t) sizeof(v) || v[2] == 0)
+        return 0;
+    if (v[2] < v[1])
+        return (uint64_t) ((double) v[0] * v[1] / v[2]);
+    return v[0];
+}
+#endif
+
+ThreadLog *GetThreadLog()
+{
+    if (threadlog && threadgeneration == generation)
+        return threadlog;
+    
+    ThreadLog *log = new ThreadLog;
+    for (int e = 0; e < NumEvents; ++e) {
+        log->fds[e] = -1;
+#ifdef __linux__
+        if (useevents && available[e])
+            log->fds[e] = OpenEvent(e);
+#endif
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    log->tid = (int) logs.size();
+    log->name = logs.empty() ? "main" : "worker";
+    logs.push_back(log);
+    threadlog = log;
+    threadgeneration = generation;
+    return log;
+}
+
+long PeakRSS()
+{
+#if !defined(_WIN32) && !defined(_WIN64) && !defined(_MSC_VER)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        return usage.ru_maxrss;
+#endif
+    return 0;
+}
+
+void WriteRatio(FILE *fp, const char *name, const StageTotal &t,
+                ProfileEvent num, ProfileEvent den)
+{
+    if (available[num] && available[den] && t.events[den] > 0)
+        fprintf(fp, ", \"%s\": %.4f", name,
+                (double) t.events[num] / t.events[den]);
+}
+
+}  // namespace
+
+
+bool Profile::enabled = false;
+
+void Profile::Start(bool events)
+{
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < NumCounters; ++i)
+        counters[i] = 0;
+    
+    // Find out which events this host permits
+    useevents = false;
+    for (int e = 0; e < NumEvents; ++e)
+        available[e] = false;
+#ifdef __linux__
+    for (int e = 0; events && e < NumEvents; ++e) {
+        int fd = OpenEvent(e);
+        if (fd >= 0) {
+            available[e] = useevents = true;
+            close(fd);
+        } else if (eventerror.empty())
+            eventerror = std::string(EventNames[e]) + ": " + strerror(errno);
+    }
+#else
+    if (events)
+        eventerror = "perf events are only supported on Linux";
+#endif
+    if (events && !useevents)
+        fprintf(stderr, "Hardware counters are not available (%s).\n",
+                eventerror.c_str());
+    
+    GetThreadLog();
+    enabled = true;
+}
+
+double Profile::Now()
+{
+    return std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+void Profile::Add(ProfileCounter c, double n)
+{
+    double old = counters[c].load();
+    while (!counters[c].compare_exchange_weak(old, old + n))
+        ;
+}
+
+void Profile::NameThread(const char *name)
+{
+    if (!enabled)
+        return;
+    ThreadLog *log = GetThreadLog();
+    std::lock_guard<std::mutex> lock(log->lock);
+    log->name = name;
+}
+
+void Profile::ReadEvents(uint64_t *events)
+{
+    if (!useevents)
+        return;
+    ThreadLog *log = GetThreadLog();
+    for (int e = 0; e < NumEvents; ++e) {
+#ifdef __linux__
+        events[e] = ReadEvent(log->fds[e]);
+#else
+        events[e] = 0;
+#endif
+    }
+}
+
+void Profile::AddSpan(const char *name, double begin, double end,
+                      const uint64_t *events)
+{
+    Span span;
+    span.name = name;
+    span.begin = begin;
+    span.end = end;
+    if (useevents) {
+        ReadEvents(span.events);
+        for (int e = 0; e < NumEvents; ++e)
+            span.events[e] -= events[e];
+    }
+    ThreadLog *log = GetThreadLog();
+    std::lock_guard<std::mutex> lock(log->lock);
+    log->spans.push_back(span);
+}
+
+void Profile::SampleMemory()
+{
+    if (!enabled)
+        return;
+    MemorySample sample = { Now(), PeakRSS() };
+    std::lock_guard<std::mutex> lock(mutex);
+    memory.push_back(sample);
+}
+
+bool Profile::Write(const std::string &fname)
+{
+    FILE *fp = fopen(fname.c_str(), "w");
+    if (!fp)
+        return false;
+    SampleMemory();
+    const double end = Now();
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<std::string, StageTotal> totals;
+    fprintf(fp, "{\"traceEvents\": [\n");
+    const char *sep = "";
+    for (unsigned int i = 0; i < logs.size(); ++i) {
+        // Copied, so the thread is not held up while the file is written
+        ThreadLog *log = logs[i];
+        std::string name;
+        std::vector<Span> spans;
+        {
+            std::lock_guard<std::mutex> loglock(log->lock);
+            name = log->name;
+            spans = log->spans;
+        }
+        fprintf(fp, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+                "\"tid\": %d, \"args\": {\"name\": \"%s %d\"}}",
+                sep, log->tid, name.c_str(), log->tid);
+        sep = ",\n";
+        for (unsigned int j = 0; j < spans.size(); ++j) {
+            const Span &s = spans[j];
+            fprintf(fp, ",\n{\"name\": \"%s\", \"cat\": \"psa\", \"ph\": \"X\", "
+                    "\"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %d",
+                    s.name, s.begin, s.end - s.begin, log->tid);
+            if (useevents) {
+                const char *argsep = ", \"args\": {";
+                for (int e = 0; e < NumEvents; ++e) {
+                    if (!available[e]) continue;
+                    fprintf(fp, "%s\"%s\": %llu", argsep, EventNames[e],
+                            (unsigned long long) s.events[e]);
+                    argsep = ", ";
+                }
+                fprintf(fp, "}");
+            }
+            fprintf(fp, "}");
+            
+            std::map<std::string, StageTotal>::iterator it = totals.find(s.name);
+            if (it == totals.end()) {
+                StageTotal t;
+                memset(&t, 0, sizeof(t));
+                it = totals.insert(std::make_pair(std::string(s.name), t)).first;
+            }
+            it->second.count++;
+            it->second.time += s.end - s.begin;
+            for (int e = 0; useevents && e < NumEvents; ++e)
+                it->second.events[e] += s.events[e];
+        }
+    }
+    for (unsigned int i = 0; i < memory.size(); ++i)
+        fprintf(fp, "%s{\"name\": \"peak RSS\", \"ph\": \"C\", \"ts\": %.3f, "
+                "\"pid\": 1, \"args\": {\"MB\": %.3f}}",
+                sep, memory[i].time, memory[i].kb / 1024.0);
+    
+    fprintf(fp, "\n],\n\"displayTimeUnit\": \"ms\",\n\"otherData\": {\n");
+    fprintf(fp, "  \"seconds\": %.6f,\n", end * 1e-6);
+    fprintf(fp, "  \"peak_rss_kb\": %ld,\n", PeakRSS());
+    for (int i = 0; i < NumCounters; ++i)
+        fprintf(fp, "  \"%s\": %.0f,\n", CounterNames[i], counters[i].load());
+    if (!eventerror.empty())
+        fprintf(fp, "  \"events_error\": \"%s\",\n", eventerror.c_str());
+    
+    // Summed over threads, so parallel stages may exceed the wall time
+    fprintf(fp, "  \"stages\": {");
+    sep = "\n";
+    for (std::map<std::string, StageTotal>::const_iterator it = totals.begin();
+         it != totals.end(); ++it) {
+        const StageTotal &t = it->second;
+        fprintf(fp, "%s    \"%s\": {\"count\": %d, \"seconds\": %.6f", sep,
+                it->first.c_str(), t.count, t.time * 1e-6);
+        for (int e = 0; useevents && e < NumEvents; ++e)
+            if (available[e])
+                fprintf(fp, ", \"%s\": %llu", EventNames[e],
+                        (unsigned long long) t.events[e]);
+        if (useevents) {
+            WriteRatio(fp, "ipc", t, EventInstructions, EventCycles);
+            WriteRatio(fp, "cache_miss_rate", t, EventCacheMisses,
+                       EventCacheReferences);
+            WriteRatio(fp, "branch_miss_rate", t, EventBranchMisses,
+                       EventBranches);
+        }
+        fprintf(fp, "}");
+        sep = ",\n";
+    }
+    fprintf(fp, "\n  }\n}}\n");
+    return fclose(fp) == 0;
+}
+
+void Profile::Stop()
+{
+    enabled = false;
+    std::lock_guard<std::mutex> lock(mutex);
+    for (unsigned int i = 0; i < logs.size(); ++i) {
+#ifdef __linux__
+        for (int e = 0; e < NumEvents; ++e)
+            if (logs[i]->fds[e] >= 0)
+                close(logs[i]->fds[e]);
+#endif
+        delete logs[i];
+    }
+    logs.clear();
+    memory.clear();
+    ++generation;
+}
@@ -0,0 +1,105 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <string>
+
+// Low-overhead instrumentation for --profile. Stages are timed by placing a
+// ProfileScope at their beginning; every thread records its spans into its
+// own buffer, so OpenMP regions show one span per thread. Nothing is recorded
+// until Profile::Start() is called, the cost of an idle scope is one branch.
+// Write() saves everything as a Chrome trace (chrome://tracing, Perfetto),
+// with the counters, per-stage totals and the peak resident set size in
+// 'otherData'; threads may go on recording meanwhile. Stop() ends recording
+// and frees the spans and events of all threads, which must have left their
+// scopes by then.
+//
+// With hardware events enabled, each thread opens its own Linux perf events
+// on its first span, and every span also records the events of its thread.
+// Stages that fan out over OpenMP threads, like the FT, are thus covered in
+// full by their per-thread spans ('ft worker', 'ft column'). Events that
+// cannot be opened, e.g. for lack of permission, are left out of the report.
+
+enum ProfileCounter {
+    CounterSets,           // point sets analyzed
+    CounterPairs,          // point pairs binned into RDFs
+    CounterFrequencies,    // frequencies of spectra evaluated
+    CounterTerms,          // points times frequencies of spectra
+    NumCounters
+};
+
+// Hardware and software events recorded per span when enabled
+enum ProfileEvent {
+    EventCycles,
+    EventInstructions,
+    EventCacheReferences,
+    EventCacheMisses,
+    EventBranches,
+    EventBranchMisses,
+    EventTaskClock,        // CPU time in nanoseconds
+    NumEvents
+};
+
+class Profile
+{
+public:
+    static void Start(bool events = false);
+    static bool Write(const std::string &fname);
+    static void Stop();
+    static bool Enabled() { return enabled; }
+    
+    static void Count(ProfileCounter c, double n) { if (enabled) Add(c, n); }
+    static void NameThread(const char *name);
+    static void SampleMemory();
+    
+    // Microseconds since Start()
+    static double Now();
+    static void ReadEvents(uint64_t *events);
+    static void AddSpan(const char *name, double begin, double end,
+                        const uint64_t *events);
+    
+private:
+    static void Add(ProfileCounter c, double n);
+    static bool enabled;
+};
+
+class ProfileScope
+{
+    const char *name;
+    double begin;
+    uint64_t events[NumEvents];
+public:
+    explicit ProfileScope(const char *name) : name(name), begin(0) {
+        if (Profile::Enabled()) {
+            Profile::ReadEvents(events);
+            begin = Profile::Now();
+        }
+    }
+    ~ProfileScope() {
+        if (Profile::Enabled())
+            Profile::AddSpan(name, begin, Profile::Now(), events);
+    }
+};
+
+#endif  // PROFILE_H
@@ -0,0 +1,363 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "psa.h"
+#include "chunked.h"
+#include "profile.h"
+#include "tiled.h"
+#include "tune.h"
+#include "util.h"
+#include <climits>
+
+
+const char *PsaStatusString(int status)
+{
+    switch (status) {
+        case PsaOK:            return "no error";
+        case PsaErrorArgument: return "invalid argument";
+        case PsaErrorLoad:     return "cannot load point set";
+        case PsaErrorImage:    return "cannot write spectrum image";
+        case PsaErrorMemory:   return "not enough memory";
+        default:               return "unknown error";
+    }
+}
+
+
+PsaContext::PsaContext()
+    : config(DefaultConfig()), spectral(NULL), rings(NULL), imagesink(NULL)
+{
+}
+
+PsaContext::PsaContext(const Config &config)
+    : config(config), spectral(NULL), rings(NULL), imagesink(NULL)
+{
+}
+
+PsaContext::~PsaContext()
+{
+    if (spectral) delete spectral;
+    if (rings) delete rings;
+}
+
+int PsaContext::Load(const std::string &fname, PointSet *points)
+{
+    if (!points)
+        return PsaErrorArgument;
+    if (!PointSet::Load(fname, points, &error))
+        return PsaErrorLoad;
+    return PsaOK;
+}
+
+int PsaContext::Analyze(const PointSet &points, const MeasureGraph &measures,
+                        PsaResult *result)
+{
+    if (points.size() < 1)
+        return PsaErrorArgument;
+    return Analyze(&points.points[0], points.size(), measures, result);
+}
+
+// The indices of the frequency grids are ints
+static bool GridFits(int size)
+{
+    return 2. * size * size <= INT_MAX;
+}
+
+int PsaContext::Analyze(const Point *points, int npoints,
+                        const MeasureGraph &measures, PsaResult *result)
+{
+    if (!points || npoints < 1 || !result)
+        return PsaErrorArgument;
+    try {
+        return AnalyzePoints(points, npoints, measures, result);
+    } catch (std::bad_alloc &) {
+        return MemoryError("Not enough memory for the measures.");
+    }
+}
+
+int PsaContext::AnalyzePoints(const Point *points, int npoints,
+                              const MeasureGraph &measures, PsaResult *result)
+{
+    ProfileScope scope("analyze");
+    Profile::Count(CounterSets, 1);
+    
+    const float fnorm = 2.f / sqrtf(npoints);
+    const float rnorm = 1.f / sqrtf(2.f / (SQRT3 * npoints));
+    const int ftsize  = config.frange / fnorm;
+    
+    result->npoints = npoints;
+    result->stats = Statistics();
+    result->rdf = Curve();
+    result->rdferror = Curve();
+    result->rp = Curve();
+    result->ani = Curve();
+    result->periodogram = Periodogram();
+    result->spectrum = Image();
+    
+    // The radial power tables for the spectral statistics only depend on the
+    // number of points, as does the size of the spectrum
+    const bool ft = measures.Needs(MeasurePeriodogram);
+    const bool pairs = measures.Needs(MeasurePairHistogram);
+    // Without an image, RP and ANI may come from a sample of the frequencies
+    // of each ring, see polar.h. Otherwise grids larger than config.ftmemory
+    // are computed in bands, see tiled.h. Both leave the periodogram empty,
+    // so neither is taken when the periodogram itself was requested.
+    const bool whole = measures.Requested(MeasurePeriodogram);
+    const bool polar = ft && !whole && config.rpangles > 0 &&
+                       !measures.Needs(MeasureImage);
+    // Sampled RDFs only need the Hankel engine of the spectral statistics
+    const bool sampled = pairs && config.SampledRDF();
+    const Engines engines = ((ft && !polar) || (pairs && !sampled) ||
+                             measures.Needs(MeasureFullRDF)) ?
+        TuneEngines(config, npoints) : ReferenceEngines();
+    const double ftbytes = config.ftmemory * 1048576.;
+    const bool banded = ft && !polar && ftbytes > 0 &&
+                        TiledSpectrum::GridBytes(ftsize * 2) > ftbytes;
+    if (banded && whole)
+        return MemoryError("The periodogram is larger than ftmemory.");
+    if (ft && !polar && !banded && !GridFits(ftsize * 2))
+        return MemoryError("The frequency grid is too large to be held in "
+                           "memory; set ftmemory to compute it in bands.");
+    bool imageok = true;
+    if (polar) {
+        Curve layout(ftsize * config.fbinsize, 0, ftsize);
+        if (rings && !rings->Matches(layout, config.rpangles)) {
+            delete rings;
+            rings = NULL;
+        }
+        if (!rings)
+            rings = new PolarSpectrum(layout, config.rpangles);
+    } else if (banded) {
+        spectrum = Spectrum();
+    } else if (ft && spectrum.size != ftsize * 2) {
+        spectrum = Spectrum(ftsize * 2);
+    }
+    if (measures.Needs(MeasureFullRDF))
+        PrepareSpectral(npoints, engines.hankel);
+    
+    Curve fullrdf;
+    const bool ok = RunStages([&]() {
+        if (polar) {
+            ProfileScope scope("ft rings");
+            Curve rp, ani;
+            rings->Compute(points, npoints, &rp,
+                           measures.Needs(MeasureAnisotropy) ? &ani : NULL);
+            if (measures.Needs(MeasureRP))
+                result->rp = rp;
+            if (measures.Needs(MeasureAnisotropy))
+                result->ani = ani;
+        } else if (banded) {
+            ProfileScope scope("ft bands");
+            const int size = ftsize * 2;
+            TiledSpectrum tiled(size, TiledSpectrum::BandRows(size, ftbytes),
+                                config.ftdownsample);
+            ImageCollector collector(&result->spectrum);
+            ImageSink *sink = NULL;
+            if (measures.Needs(MeasureImage))
+                sink = imagesink ? imagesink : &collector;
+            Curve rp(ftsize * config.fbinsize, 0, ftsize);
+            Curve ani(rp.size(), 0, ftsize);
+            imageok = tiled.Compute(points, npoints, &rp,
+                measures.Needs(MeasureAnisotropy) ? &ani : NULL, sink);
+            if (measures.Needs(MeasureRP))
+                result->rp = rp;
+            if (measures.Needs(MeasureAnisotropy))
+                result->ani = ani;
+        } else if (ft) {
+            {
+                ProfileScope scope("ft");
+                EngineSpectrum(engines, &spectrum, points, npoints);
+            }
+            ProfileScope scope("periodogram");
+            result->periodogram = Periodogram(spectrum);
+            result->periodogram.Divide(npoints);
+        }
+    }, [&]() {
+        // All RDFs share a single pass over the pairs of points
+        if (!pairs)
+            return;
+        std::vector<Curve *> rdfs, errors;
+        if (measures.Needs(MeasureRDF)) {
+            float maxdist = config.rrange / rnorm;
+            int nbins = config.rbinsize * npoints;
+            result->rdf = Curve(nbins, 0, maxdist);
+            rdfs.push_back(&result->rdf);
+            errors.push_back(&result->rdferror);
+        }
+        if (measures.Needs(MeasureFullRDF)) {
+            fullrdf = spectral->RDFLayout();
+            rdfs.push_back(&fullrdf);
+        }
+        ConfigRDF(config, engines, points, npoints, rdfs, errors);
+        if (measures.Needs(MeasureSpectralStats)) {
+            ProfileScope scope("spectral stats");
+            spectral->AddRDF(fullrdf);
+            spectral->GetStatistics(&result->stats);
+        }
+    }, [&]() {
+        if (measures.Needs(MeasureSpatialStats)) {
+            ProfileScope scope("spatial stats");
+            SpatialStatistics(points, npoints, &result->stats);
+        }
+    });
+    if (!ok)
+        throw std::bad_alloc();
+    
+    if (polar)
+        return PsaOK;
+    if (banded)
+        return imageok ? PsaOK : PsaErrorImage;
+    
+    DerivePeriodogram(measures, ftsize, result);
+    return PsaOK;
+}
+
+int PsaContext::Analyze(PointBlockReader &reader, int chunk,
+                        const MeasureGraph &measures, PsaResult *result)
+{
+    const long n = reader.NumPoints();
+    if (n < 1 || n > INT_MAX || chunk < 1 || !result)
+        return PsaErrorArgument;
+    try {
+        return AnalyzeBlocks(reader, chunk, measures, result);
+    } catch (std::bad_alloc &) {
+        return MemoryError("Not enough memory for the measures.");
+    }
+}
+
+int PsaContext::AnalyzeBlocks(PointBlockReader &reader, int chunk,
+                              const MeasureGraph &measures, PsaResult *result)
+{
+    const long n = reader.NumPoints();
+    ProfileScope scope("analyze");
+    Profile::Count(CounterSets, 1);
+    
+    const int npoints = n;
+    const float fnorm = 2.f / sqrtf(npoints);
+    const float rnorm = 1.f / sqrtf(2.f / (SQRT3 * npoints));
+    const int ftsize  = config.frange / fnorm;
+    
+    result->npoints = npoints;
+    result->stats = Statistics();
+    result->rdf = Curve();
+    result->rdferror = Curve();
+    result->rp = Curve();
+    result->ani = Curve();
+    result->periodogram = Periodogram();
+    result->spectrum = Image();
+    
+    // The stages run one after another, each of them on all threads, so that
+    // there is only one pass over the blocks at a time
+    const bool ft = measures.Needs(MeasurePeriodogram);
+    const bool pairs = measures.Needs(MeasurePairHistogram);
+    const Engines engines = (ft || pairs) ? TuneEngines(config, npoints) :
+                                            ReferenceEngines();
+    if (ft) {
+        if (!GridFits(ftsize * 2))
+            return MemoryError("The frequency grid is too large to be held "
+                               "in memory.");
+        if (spectrum.size != ftsize * 2)
+            spectrum = Spectrum(ftsize * 2);
+        {
+            ProfileScope scope("ft");
+            if (!ChunkedSpectrum(reader, chunk, &spectrum))
+                return BlockError();
+        }
+        ProfileScope scope("periodogram");
+        result->periodogram = Periodogram(spectrum);
+        result->periodogram.Divide(npoints);
+    }
+    if (pairs) {
+        std::vector<Curve *> rdfs;
+        Curve fullrdf;
+        if (measures.Needs(MeasureRDF)) {
+            float maxdist = config.rrange / rnorm;
+            int nbins = config.rbinsize * npoints;
+            result->rdf = Curve(nbins, 0, maxdist);
+            rdfs.push_back(&result->rdf);
+        }
+        if (measures.Needs(MeasureFullRDF)) {
+            PrepareSpectral(npoints, engines.hankel);
+            fullrdf = spectral->RDFLayout();
+            rdfs.push_back(&fullrdf);
+        }
+        {
+            ProfileScope scope("rdf");
+            if (!ChunkedRDF(reader, chunk, rdfs))
+                return BlockError();
+        }
+        if (measures.Needs(MeasureSpectralStats)) {
+            ProfileScope scope("spectral stats");
+            spectral->AddRDF(fullrdf);
+            spectral->GetStatistics(&result->stats);
+        }
+    }
+    
+    DerivePeriodogram(measures, ftsize, result);
+    return PsaOK;
+}
+
+int PsaContext::BlockError()
+{
+    error = "Cannot read the points in blocks.";
+    return PsaErrorLoad;
+}
+
+int PsaContext::MemoryError(const std::string &what)
+{
+    // The buffers of a failed call are not kept
+    spectrum = Spectrum();
+    error = what;
+    return PsaErrorMemory;
+}
+
+void PsaContext::PrepareSpectral(int npoints, int hankel)
+{
+    if (spectral && spectral->NumPoints() != npoints) {
+        delete spectral;
+        spectral = NULL;
+    }
+    if (!spectral)
+        spectral = new SpectralAverage(npoints);
+    spectral->Reset();
+    spectral->SetHankel(hankel);
+}
+
+void PsaContext::DerivePeriodogram(const MeasureGraph &measures, int ftsize,
+                                   PsaResult *result)
+{
+    if (measures.Needs(MeasureRP)) {
+        ProfileScope scope("rp");
+        int nbins = ftsize * config.fbinsize;
+        result->rp = Curve(nbins, 0, ftsize);
+        result->periodogram.RadialPower(&result->rp);
+    }
+    if (measures.Needs(MeasureAnisotropy)) {
+        ProfileScope scope("ani");
+        result->ani = Curve(result->rp.size(), 0, ftsize);
+        result->periodogram.Anisotropy(&result->ani, result->rp);
+    }
+    if (measures.Needs(MeasureImage)) {
+        ProfileScope scope("image");
+        result->spectrum = Image(ftsize * 2, ftsize * 2);
+        result->periodogram.ToImage(&result->spectrum);
+        result->spectrum.ToneMap(true);
+    }
+}
@@ -0,0 +1,134 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PSA_H
+#define PSA_H
+
+#include "chunked.h"
+#include "config.h"
+#include "curve.h"
+#include "gradient.h"
+#include "image.h"
+#include "incremental.h"
+#include "measures.h"
+#include "periodogram.h"
+#include "point.h"
+#include "polar.h"
+#include "rdfsample.h"
+#include "spectrum.h"
+#include "statistics.h"
+#include "tiled.h"
+#include <string>
+
+// In-process interface to the analysis, built into libpsa. Nothing here
+// exits the process or writes files; failures are returned as status codes.
+// A context holds the configuration along with buffers and tables that are
+// reused by subsequent calls. Separate contexts may be used from separate
+// threads at the same time, a single context may not.
+
+enum PsaStatus {
+    PsaOK = 0,
+    PsaErrorArgument,   // no points or invalid point buffer
+    PsaErrorLoad,       // point set file missing, malformed or unreadable,
+                        // see Error()
+    PsaErrorImage,      // image sink failed, see SetImageSink()
+    PsaErrorMemory      // out of memory, a periodogram requested but larger
+                        // than Config::ftmemory, or a frequency grid too
+                        // large for memory, see Error()
+};
+
+const char *PsaStatusString(int status);
+
+// Measures that were not requested are left empty. Statistics are in the
+// units of the unit torus; NormalizeStatistics() converts them to the units
+// printed by psa. Without a spectrum image, Config::rpangles > 0 samples
+// the RP and ANI ring by ring, see polar.h. Frequency grids larger than
+// Config::ftmemory are computed in bands, see tiled.h, with the spectrum
+// image downsampled by Config::ftdownsample. Both leave the periodogram
+// empty and are only taken when the periodogram was not requested itself;
+// a requested periodogram larger than Config::ftmemory is an error. Any
+// limit of Config::rdfanchors, rdftime or rdfprecision samples the RDFs, see
+// rdfsample.h, with the standard errors of the RDF in rdferror.
+struct PsaResult {
+    Statistics stats;
+    Curve rdf;
+    Curve rdferror;
+    Curve rp;
+    Curve ani;
+    Periodogram periodogram;
+    Image spectrum;
+    int npoints;
+    
+    PsaResult() : npoints(0) {};
+};
+
+class PsaContext
+{
+public:
+    PsaContext();
+    explicit PsaContext(const Config &config);
+    ~PsaContext();
+    
+    const Config &GetConfig() const { return config; }
+    void SetConfig(const Config &config) { this->config = config; }
+    
+    // Analyzes the points for the given measures and everything they depend
+    // on. Buffers are read in place, e.g. interleaved x/y coordinates owned by
+    // the caller, and must stay valid until the call returns.
+    int Analyze(const PointSet &points, const MeasureGraph &measures,
+                PsaResult *result);
+    int Analyze(const Point *points, int npoints, const MeasureGraph &measures,
+                PsaResult *result);
+    // Analyzes a set that is read in blocks of chunk points, see chunked.h.
+    // The spatial statistics need all points at once and are left empty, and
+    // the RDFs are exact.
+    int Analyze(PointBlockReader &reader, int chunk,
+                const MeasureGraph &measures, PsaResult *result);
+    
+    // Sends the spectrum images of banded grids to sink in place of
+    // PsaResult::spectrum, e.g. a PngStream, until reset to NULL
+    void SetImageSink(ImageSink *sink) { imagesink = sink; }
+    
+    int Load(const std::string &fname, PointSet *points);
+    const std::string &Error() const { return error; }
+    
+private:
+    PsaContext(const PsaContext &);
+    PsaContext& operator= (const PsaContext &);
+    int AnalyzePoints(const Point *points, int npoints,
+                      const MeasureGraph &measures, PsaResult *result);
+    int AnalyzeBlocks(PointBlockReader &reader, int chunk,
+                      const MeasureGraph &measures, PsaResult *result);
+    int BlockError();
+    int MemoryError(const std::string &what);
+    void PrepareSpectral(int npoints, int hankel);
+    void DerivePeriodogram(const MeasureGraph &measures, int ftsize,
+                           PsaResult *result);
+    
+    Config config;
+    std::string error;
+    Spectrum spectrum;
+    SpectralAverage *spectral;
+    PolarSpectrum *rings;
+    ImageSink *imagesink;
+};
+
+#endif  // PSA_H
@@ -0,0 +1,213 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rdfsample.h"
+#include "profile.h"
+#include "util.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+// Sums of the neighbour counts of the anchors in each bin, and of their
+// squares
+struct AnchorSums {
+    std::vector<std::vector<double> > sum, sumsq;
+    
+    explicit AnchorSums(const std::vector<Curve *> &rdfs)
+        : sum(rdfs.size()), sumsq(rdfs.size()) {
+        for (size_t k = 0; k < rdfs.size(); ++k) {
+            sum[k].assign(rdfs[k]->size(), 0.0);
+            sumsq[k].assign(rdfs[k]->size(), 0.0);
+        }
+    }
+};
+
+// Counts the neighbours of the anchors [begin, end) bin by bin and adds the
+// counts to sums. Only the bins an anchor has touched are added and reset,
+// since most stay empty when there are many bins.
+static void SampleBlock(const Point *points, const CellGrid &grid,
+                        const int *anchors, long begin, long end,
+                        const std::vector<Curve *> &rdfs, AnchorSums &sums)
+{
+    const int ncurves = rdfs.size(), m = grid.m;
+    AnchorSums local(rdfs);
+    std::vector<std::vector<unsigned int> > count(ncurves);
+    std::vector<std::vector<int> > touched(ncurves);
+    for (int k = 0; k < ncurves; ++k)
+        count[k].assign(rdfs[k]->size(), 0);
+    for (long a = begin; a < end; ++a) {
+        const int i = anchors[a];
+        const int cx = grid.cell[i] % m, cy = grid.cell[i] / m;
+        // A single cell holds all points
+        const int ncells = (m == 1) ? 1 : 9;
+        for (int nc = 0; nc < ncells; ++nc) {
+            const int c = (m == 1) ? 0 : (cx + nc % 3 - 1 + m) % m +
+                                         ((cy + nc / 3 - 1 + m) % m) * m;
+            for (int n = grid.start[c]; n < grid.start[c+1]; ++n) {
+                const int j = grid.order[n];
+                if (j == i) continue;
+                float dist = points[i].DistUnitTorus(points[j]);
+                for (int k = 0; k < ncurves; ++k) {
+                    int idx = rdfs[k]->ToIndex(dist);
+                    if (0 <= idx && idx < rdfs[k]->size() &&
+                        count[k][idx]++ == 0)
+                        touched[k].push_back(idx);
+                }
+            }
+        }
+        for (int k = 0; k < ncurves; ++k) {
+            for (size_t t = 0; t < touched[k].size(); ++t) {
+                const int b = touched[k][t];
+                const double c = count[k][b];
+                local.sum[k][b] += c;
+                local.sumsq[k][b] += c * c;
+                count[k][b] = 0;
+            }
+            touched[k].clear();
+        }
+    }
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+    for (int k = 0; k < ncurves; ++k)
+        for (size_t b = 0; b < local.sum[k].size(); ++b) {
+            sums.sum[k][b] += local.sum[k][b];
+            sums.sumsq[k][b] += local.sumsq[k][b];
+        }
+}
+
+// RDFs and standard errors from the counts of n anchors. Returns the largest
+// RMS error of the curves.
+static float Estimate(int npoints, long n, const AnchorSums &sums,
+                      const std::vector<Curve *> &rdfs,
+                      const std::vector<Curve *> &errors)
+{
+    // Finite population correction, which is 0 once all points are anchors
+    const double fpc = 1.0 - (double) n / npoints;
+    float rms = 0.f;
+    for (size_t k = 0; k < rdfs.size(); ++k) {
+        Curve *rdf = rdfs[k];
+        Curve *err = (k < errors.size()) ? errors[k] : NULL;
+        if (err) *err = *rdf;
+        double sumsq = 0.0;
+        for (int i = 0; i < rdf->size(); ++i) {
+            // Same normalization as NormalizeRDF for the mean count
+            const double scale = (npoints - 1.0) * PI * rdf->dx * rdf->dx *
+                                 (2*i + 1);
+            // Bins where all anchors have the same count, typically none,
+            // have no spread, yet other points may have pairs there; their
+            // variance is at least that of a single pair the sample missed
+            const double mean = sums.sum[k][i] / n;
+            const double var = (n > 1) ? std::max(1.0 / n,
+                (sums.sumsq[k][i] - n * mean * mean) / (n - 1)) : 0.0;
+            const double se = sqrt(var / n * fpc) / scale;
+            (*rdf)[i] = mean / scale;
+            if (err) (*err)[i] = se;
+            sumsq += se * se;
+        }
+        if (rdf->size() > 0)
+            rms = std::max(rms, (float) sqrt(sumsq / rdf->size()));
+    }
+    return rms;
+}
+
+long SampleRDF(const Point *points, int npoints, const RDFBudget &budget,
+               const std::vector<Curve *> &rdfs,
+               const std::vector<Curve *> &errors, unsigned int seed)
+{
+    if (npoints < 2) {
+        for (size_t k = 0; k < rdfs.size(); ++k) {
+            rdfs[k]->y.assign(rdfs[k]->size(), 0.f);
+            if (k < errors.size() && errors[k])
+                *errors[k] = *rdfs[k];
+        }
+        return 0;
+    }
+    float range = 0.f;
+    for (size_t k = 0; k < rdfs.size(); ++k)
+        range = std::max(range, rdfs[k]->x0 + rdfs[k]->size() * rdfs[k]->dx);
+    CellGrid grid;
+    grid.Build(points, npoints, range);
+    
+    AnchorSums sums(rdfs);
+    std::vector<int> anchors(npoints);
+    for (int i = 0; i < npoints; ++i)
+        anchors[i] = i;
+    std::mt19937 rng(seed);
+    const long limit = (budget.anchors > 0) ?
+        std::min(budget.anchors, (long) npoints) : npoints;
+    const double start = Profile::Now();
+    long n = 0, next = std::min(limit, 1024L);
+    while (n < next) {
+        // The anchors of the round are a partial Fisher-Yates shuffle
+        for (long a = n; a < next; ++a) {
+            std::uniform_int_distribution<long> pick(a, npoints - 1);
+            std::swap(anchors[a], anchors[pick(rng)]);
+        }
+        Profile::Count(CounterPairs, (next - n) * (npoints - 1.0));
+        const long first = n, round = next - n;
+        const int nblocks = std::min(round, 64L);
+#if defined(_OPENMP) && _OPENMP >= 201511
+        if (omp_in_parallel()) {
+#pragma omp taskloop grainsize(1) shared(grid, anchors, sums)
+            for (int b = 0; b < nblocks; ++b)
+                SampleBlock(points, grid, &anchors[0],
+                            first + b * round / nblocks,
+                            first + (b + 1) * round / nblocks, rdfs, sums);
+        } else
+#endif
+        {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+            for (int b = 0; b < nblocks; ++b)
+                SampleBlock(points, grid, &anchors[0],
+                            first + b * round / nblocks,
+                            first + (b + 1) * round / nblocks, rdfs, sums);
+        }
+        n = next;
+        
+        const float error = Estimate(npoints, n, sums, rdfs, errors);
+        if (budget.precision > 0.f && error <= budget.precision)
+            break;
+        // The error shrinks with the square root of the anchors, so the
+        // count that reaches the precision is extrapolated, but at most
+        // quadrupled per round; the time per anchor so far bounds the count
+        // that fits into the time left
+        double target = 2.0 * n;
+        if (budget.precision > 0.f) {
+            const double ratio = error / budget.precision;
+            target = std::min(4.0 * n,
+                              std::max(n + 64.0, 1.1 * n * ratio * ratio));
+        }
+        if (budget.seconds > 0.f) {
+            const double elapsed = std::max(Profile::Now() - start, 1.0);
+            target = std::min(target, n * (budget.seconds * 1e6 / elapsed));
+        }
+        next = (long) std::min(target, (double) limit);
+    }
+    return n;
+}
@@ -0,0 +1,57 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RDFSAMPLE_H
+#define RDFSAMPLE_H
+
+#include "curve.h"
+#include "point.h"
+#include <vector>
+
+// Limits of a sampled RDF. Sampling stops at whichever limit is reached
+// first, and at the latest once every point has been an anchor.
+struct RDFBudget {
+    long anchors;     // maximum number of anchor points (0: no limit)
+    float seconds;    // maximum time (0: no limit)
+    float precision;  // target RMS standard error over the bins (0: none)
+    
+    RDFBudget() : anchors(0), seconds(0.f), precision(0.f) {}
+};
+
+// Estimates the RDFs of large sets from the pairs of randomly drawn anchor
+// points with all other points, found in a cell grid, instead of from all
+// pairs. Each anchor counts its neighbours in every bin; the RDF is the
+// mean count scaled like NormalizeRDF(), so that with all points as anchors
+// it equals PointSet::RDF(). The standard error of each bin follows from
+// the spread of the counts over the anchors, which are drawn without
+// replacement, but is never below that of a single pair missed by them.
+//
+// Anchors are drawn in rounds. After each round the number needed to reach
+// the target precision is extrapolated from the errors so far, since they
+// shrink with the square root of the number of anchors, and the next round
+// is sized by it and by what is left of the budget. The standard errors are
+// stored in errors[k] (entries may be NULL) in the layout of rdfs[k].
+// Returns the number of anchors.
+long SampleRDF(const Point *points, int npoints, const RDFBudget &budget,
+               const std::vector<Curve *> &rdfs,
+               const std::vector<Curve *> &errors, unsigned int seed = 1);
+
+#endif  // RDFSAMPLE_H
@@ -20,15 +20,136 @@
  */
 
 #include "result.h"
+#include "profile.h"
 #include "util.h"
 #include <iostream>
 #include <iomanip>
 #include <sstream>
+#include <stdint.h>
 #include <cairo/cairo-pdf.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+// Samples per pixel and axis of the bitmaps of large sets
+static const int RasterSamples = 4;
+
+void RasterizePoints(const PointSet &points, int res, float radius,
+                     std::vector<float> *coverage)
+{
+    const int npoints = points.size();
+    coverage->assign(res * res, 0.f);
+    
+    // Points sorted by pixel row, so that each row of the bitmap visits
+    // only the points within the radius
+    std::vector<int> rowstart(res + 2, 0), order(npoints);
+    for (int i = 0; i < npoints; ++i) {
+        int y = (int) (points[i].y * res);
+        rowstart[std::min(std::max(y, 0), res - 1) + 2]++;
+    }
+    for (int y = 0; y < res; ++y)
+        rowstart[y+2] += rowstart[y+1];
+    for (int i = 0; i < npoints; ++i) {
+        int y = (int) (points[i].y * res);
+        order[rowstart[std::min(std::max(y, 0), res - 1) + 1]++] = i;
+    }
+    
+    // Each pixel counts its samples inside any disc, like an antialiased
+    // fill of the circles; a disc covers a span of samples in each row
+    const int ns = RasterSamples, nx = res * ns;
+    const int reach = (int) ceilf(radius) + 1;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 16)
+#endif
+    for (int y = 0; y < res; ++y) {
+        std::vector<unsigned char> inside(ns * nx, 0);
+        for (int r = std::max(0, y - reach); r <= std::min(res - 1, y + reach);
+             ++r) {
+            for (int k = rowstart[r]; k < rowstart[r+1]; ++k) {
+                const float cx = points[order[k]].x * res;
+                const float cy = points[order[k]].y * res;
+                for (int s = 0; s < ns; ++s) {
+                    const float dy = y + (s + 0.5f) / ns - cy;
+                    if (dy * dy >= radius * radius)
+                        continue;
+                    const float w = sqrtf(radius * radius - dy * dy);
+                    const int x0 = std::max(0,
+                                            (int) ceilf((cx - w) * ns - 0.5f));
+                    const int x1 = std::min(nx - 1,
+                                            (int) floorf((cx + w) * ns - 0.5f));
+                    if (x0 <= x1)
+                        memset(&inside[s * nx + x0], 1, x1 - x0 + 1);
+                }
+            }
+        }
+        for (int x = 0; x < res; ++x) {
+            int n = 0;
+            for (int s = 0; s < ns; ++s)
+                for (int i = 0; i < ns; ++i)
+                    n += inside[s * nx + x * ns + i];
+            (*coverage)[x + y*res] = n / (float) (ns * ns);
+        }
+    }
+}
+
+// Small sets are drawn as vector circles, all filled as a single path. Large
+// sets would produce huge PDFs, so their circles are splatted into a bitmap
+// of twice the resolution instead.
+static void DrawPoints(cairo_t *cr, const PointSet &points, int csize,
+                       const Config &config)
+{
+    const float radius = 2.0;
+    const int npoints = points.size();
+    cairo_identity_matrix(cr);
+    cairo_set_source_rgba(cr, 0, 0, 0, 1);
+    
+    if (npoints < config.pointraster || config.pointraster == 0) {
+        for (int i = 0; i < npoints; ++i) {
+            float x = points[i].x * csize;
+            float y = (1.f - points[i].y) * csize;
+            cairo_new_sub_path(cr);
+            cairo_arc(cr, x, y, radius, 0, TWOPI);
+        }
+        cairo_fill(cr);
+        return;
+    }
+    
+    const int res = 2 * csize;
+    std::vector<float> coverage;
+    RasterizePoints(points, res, radius * res / csize, &coverage);
+    
+    // The PDF surface keeps a reference to the bitmap until the page is
+    // emitted, so cairo has to own its pixels
+    cairo_surface_t *image = cairo_image_surface_create(CAIRO_FORMAT_RGB24,
+                                                        res, res);
+    cairo_surface_flush(image);
+    unsigned char *data = cairo_image_surface_get_data(image);
+    const int stride = cairo_image_surface_get_stride(image);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int y = 0; y < res; ++y) {
+        uint32_t *row = (uint32_t *) (data + (res-1 - y) * stride);
+        for (int x = 0; x < res; ++x) {
+            float f = 1.f - coverage[x + y*res];
+            uint32_t g = (uint32_t) (f * 255.f + 0.5f);
+            row[x] = (g << 16) | (g << 8) | g;
+        }
+    }
+    cairo_surface_mark_dirty(image);
+    
+    cairo_scale(cr, csize / (float) res, csize / (float) res);
+    cairo_set_source_surface(cr, image, 0, 0);
+    cairo_paint(cr);
+    cairo_surface_destroy(image);
+}
+
 
 void SaveSummary(const std::string &fname, Result &result, Config &config)
 {
+    ProfileScope scope("summary");
     const float fnorm = 2.f / sqrtf(result.npoints);
     const float rnorm = 1.f / sqrtf(2.f / (SQRT3 * result.npoints));
     
@@ -44,15 +165,7 @@ void SaveSummary(const std::string &fname, Result &result, Config &config)
     cairo_surface_t *image = NULL;
     
     // Draw points
-    const float radius = 2.0;
-    cairo_identity_matrix(cr);
-    cairo_set_source_rgba(cr, 0, 0, 0, 1);
-    for (int i = 0; i < result.points.size(); ++i) {
-        float x = result.points[i].x * csize;
-        float y = (1.f - result.points[i].y) * csize;
-        cairo_arc(cr, x, y, radius, 0, TWOPI);
-        cairo_fill(cr);
-    }
+    DrawPoints(cr, result.points, csize, config);
     
     // Draw radial power reference level
     cairo_identity_matrix(cr);
@@ -204,51 +317,66 @@ void SaveSummary(const std::string &fname, Result &result, Config &config)
 }
 
 void WriteResult(const std::string &base, Result &result, Config &config,
-                 ParamList &params)
+                 ParamList &params, bool header)
 {
-    const float fnorm = 2.f / sqrtf(result.npoints);
-    const float rnorm = 1.f / sqrtf(2.f / (SQRT3 * result.npoints));
+    PrintResult(base, result, params, header);
+    SaveResult(base, result, config, params);
+}
+
+void PrintResult(const std::string &base, Result &result, ParamList &params,
+                 bool header)
+{
+    Statistics stats = result.stats;
+    NormalizeStatistics(&stats, result.npoints);
     
     // Statistics
-    if (!params.GetString("convert").empty()) {
-        std::string ext = params.GetString("convert");
-        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-        std::string dot = (ext[0] != '.') ? "." : "";
-        result.points.Save(base+dot+ext);
-    }
     if (params.GetBool("spatial") || params.GetBool("spectral") || params.GetBool("stats")) {
-        static bool first = true;
-        if (first) {
+        if (header) {
 #ifdef PSA_HAS_CGAL
             printf("%-16s\tG-MD\tA-MD\tBOO\tE-Nyq.\tOsci.\n", "File");
 #else
             printf("%-16s\tG-MD\tA-MD\tE-Nyq.\tOsci.\n", "File");
 #endif
-            first = false;
         }
         printf("%-16s", base.c_str());
         std::cout << std::fixed << std::setprecision(3) << std::setw(3);
 #ifdef PSA_HAS_CGAL
         if (params.GetBool("spatial") || params.GetBool("stats"))
-            std::cout << "\t" << result.stats.mindist * rnorm
-                      << "\t" << result.stats.avgmindist * rnorm
-                      << "\t" << result.stats.orientorder;
+            std::cout << "\t" << stats.mindist
+                      << "\t" << stats.avgmindist
+                      << "\t" << stats.orientorder;
         else
             std::cout << "\t-\t-\t-";
 #else
         if (params.GetBool("spatial") || params.GetBool("stats"))
-            std::cout << "\t" << result.stats.mindist * rnorm
-                      << "\t" << result.stats.avgmindist * rnorm;
+            std::cout << "\t" << stats.mindist
+                      << "\t" << stats.avgmindist;
         else
             std::cout << "\t-\t-";
 #endif
         if (params.GetBool("spectral") || params.GetBool("stats"))
-            std::cout << "\t" << result.stats.effnyquist * fnorm
-                      << "\t" << result.stats.oscillations;
+            std::cout << "\t" << stats.effnyquist
+                      << "\t" << stats.oscillations;
         else
             std::cout << "\t-\t-";
         std::cout << "\n";
     }
+}
+
+void SaveResult(const std::string &base, Result &result, Config &config,
+                ParamList &params)
+{
+    ProfileScope scope("save");
+    const float fnorm = 2.f / sqrtf(result.npoints);
+    const float rnorm = 1.f / sqrtf(2.f / (SQRT3 * result.npoints));
+    
+    // Points
+    if (!params.GetString("convert").empty()) {
+        std::string ext = params.GetString("convert");
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        std::string dot = (ext[0] != '.') ? "." : "";
+        result.points.Save(base+dot+ext, params.GetInt("qbits", 24));
+    }
     // 1D
     if (params.GetBool("rp")) {
         std::string ylabel = (result.nsets > 1) ? "power" : "amplitude";
@@ -263,7 +391,8 @@ void WriteResult(const std::string &base, Result &result, Config &config,
         std::string labels[2] = { "distance", "rdf" };
         float yrange[2] = { config.rymin, config.rymax };
         if (params.GetBool("raw"))
-            result.rdf.SaveTXT(base+"_rdf.txt");
+            result.rdf.SaveTXT(base+"_rdf.txt", result.rdferror.size() ?
+                               &result.rdferror : NULL);
         else
             result.rdf.SaveTEX(base+"_rdf.tex", labels, yrange, 1.f, rnorm);
     }
@@ -278,7 +407,91 @@ void WriteResult(const std::string &base, Result &result, Config &config,
                                (result.nsets > 1 ? -result.nsets : 0), fnorm);
     }
     // 2D
-    if (params.GetBool("pspectrum"))
+    if (params.GetBool("pspectrum") && result.spectrum.width > 0)
         result.spectrum.Save(base+"_spec.png");
 }
 
+
+
+ResultWriter::ResultWriter(Config &config, ParamList &params, int nthreads)
+    : config(config), params(params), threadparams(nthreads, params),
+      capacity(nthreads + 1), header(true), finishing(false)
+{
+    // Each thread gets its own copy of the parameters, as looking them up
+    // marks them as used
+    for (int i = 0; i < nthreads; ++i)
+        threads.push_back(std::thread(&ResultWriter::Run, this, i));
+}
+
+void ResultWriter::Write(const std::string &base, Result &result,
+                         bool summary)
+{
+    if (!summary) {
+        PrintResult(base, result, params, header);
+        header = false;
+    }
+    if (threads.empty()) {
+        if (summary)
+            SaveSummary(base+".pdf", result, config);
+        else
+            SaveResult(base, result, config, params);
+        return;
+    }
+    
+    std::unique_lock<std::mutex> lock(mutex);
+    while ((int) queue.size() >= capacity)
+        notFull.wait(lock);
+    queue.push_back(Job());
+    queue.back().base = base;
+    queue.back().output = summary ? base+".pdf" : base;
+    queue.back().result = result;
+    queue.back().summary = summary;
+    notEmpty.notify_one();
+}
+
+void ResultWriter::Run(int thread)
+{
+    Profile::NameThread("writer");
+    for (;;) {
+        Job job;
+        {
+            // The first job whose output no other thread is writing
+            std::unique_lock<std::mutex> lock(mutex);
+            std::deque<Job>::iterator it;
+            for (;;) {
+                it = queue.begin();
+                while (it != queue.end() && writing.count(it->output))
+                    ++it;
+                if (it != queue.end() || (queue.empty() && finishing))
+                    break;
+                notEmpty.wait(lock);
+            }
+            if (it == queue.end())
+                return;
+            job = *it;
+            queue.erase(it);
+            writing.insert(job.output);
+            notFull.notify_one();
+        }
+        if (job.summary)
+            SaveSummary(job.output, job.result, config);
+        else
+            SaveResult(job.base, job.result, config, threadparams[thread]);
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        writing.erase(job.output);
+        notEmpty.notify_all();
+    }
+}
+
+void ResultWriter::Finish()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        finishing = true;
+        notEmpty.notify_all();
+    }
+    for (unsigned int i = 0; i < threads.size(); ++i)
+        threads[i].join();
+    threads.clear();
+}
@@ -28,12 +28,19 @@
 #include "param.h"
 #include "point.h"
 #include "statistics.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
 
 struct Result {
     Statistics stats;
     PointSet points;
     Curve rp;
     Curve rdf;
+    Curve rdferror;
     Curve ani;
     Image spectrum;
     int npoints;
@@ -41,8 +48,61 @@ struct Result {
 };
 
 void SaveSummary(const std::string &fname, Result &result, Config &config);
+
+// Coverage of a res x res bitmap of the unit square by discs of the given
+// radius in pixels around the points, as summaries show large sets; row 0 is
+// at y = 0
+void RasterizePoints(const PointSet &points, int res, float radius,
+                     std::vector<float> *coverage);
 void WriteResult(const std::string &base, Result &result, Config &config,
-                 ParamList &params);
+                 ParamList &params, bool header = true);
+void PrintResult(const std::string &base, Result &result, ParamList &params,
+                 bool header = true);
+void SaveResult(const std::string &base, Result &result, Config &config,
+                ParamList &params);
+
+
+// Renders results on background threads, so that the next point set can be
+// analyzed while the previous one is written. Statistics are still printed by
+// the calling thread to keep their order. At most one result per thread plus
+// one more is queued; Write() blocks while the queue is full.
+// Threads render different outputs at the same time, each through its own
+// cairo surface and libpng structs, which share no state. Results for the
+// same output, e.g. a file given twice, are written one after the other in
+// the order of Write(), so the last one is kept as without threads.
+class ResultWriter
+{
+public:
+    ResultWriter(Config &config, ParamList &params, int nthreads);
+    ~ResultWriter() { Finish(); }
+    
+    void Write(const std::string &base, Result &result, bool summary);
+    void Finish();
+    
+private:
+    struct Job {
+        std::string base;
+        std::string output;  // base of the files, with .pdf for summaries
+        Result result;
+        bool summary;
+    };
+    
+    ResultWriter(const ResultWriter &);
+    ResultWriter& operator= (const ResultWriter &);
+    void Run(int thread);
+    
+    Config config;
+    ParamList &params;
+    std::vector<ParamList> threadparams;
+    int capacity;
+    bool header;
+    bool finishing;
+    std::deque<Job> queue;
+    std::set<std::string> writing;  // outputs of the jobs being written
+    std::mutex mutex;
+    std::condition_variable notEmpty, notFull;
+    std::vector<std::thread> threads;
+};
 
 #endif // RESULT_H
 
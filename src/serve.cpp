@@ -0,0 +1,262 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "serve.h"
+#include "psa.h"
+#include "util.h"
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32) || defined(_WIN64) || defined(_MSC_VER)
+
+void Serve(const std::string &path, Config &config)
+{
+    std::cerr << "--serve is not supported on this platform.\n";
+    exit(1);
+}
+
+#else
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Largest request accepted, about 8M points, and the most clients served at
+// once, which bound the memory of the buffers of all clients to 512 MB;
+// further connections wait in the backlog
+static const uint32_t MaxRequest = 1u << 26;
+static const int MaxClients = 8;
+
+
+static bool ReadAll(int fd, void *buf, size_t n)
+{
+    uint8_t *p = static_cast<uint8_t *>(buf);
+    while (n > 0) {
+        ssize_t nn = recv(fd, p, n, 0);
+        if (nn < 0 && errno == EINTR)
+            continue;
+        if (nn <= 0)
+            return false;
+        p += nn; n -= nn;
+    }
+    return true;
+}
+
+// Reads n little endian values
+template <typename T>
+static bool ReadValues(int fd, T *p, int n)
+{
+    if (!ReadAll(fd, p, n * sizeof(T)))
+        return false;
+    if (SystemEndianness() != LittleEndian)
+        SwapEndian(p, n);
+    return true;
+}
+
+static bool WriteAll(int fd, const void *buf, size_t n)
+{
+    const uint8_t *p = static_cast<const uint8_t *>(buf);
+    while (n > 0) {
+        ssize_t nn = send(fd, p, n, MSG_NOSIGNAL);
+        if (nn < 0 && errno == EINTR)
+            continue;
+        if (nn <= 0)
+            return false;
+        p += nn; n -= nn;
+    }
+    return true;
+}
+
+// Replies are assembled in memory, little endian, and sent at once
+class Reply
+{
+    std::vector<uint8_t> data;
+public:
+    Reply() : data(4) {}
+    template <typename T>
+    void Put(const T *p, int n) {
+        const size_t first = data.size();
+        const uint8_t *b = reinterpret_cast<const uint8_t *>(p);
+        data.insert(data.end(), b, b + n * sizeof(T));
+        if (SystemEndianness() != LittleEndian)
+            SwapEndian(reinterpret_cast<T *>(&data[first]), n);
+    }
+    void PutInt(uint32_t i) { Put(&i, 1); }
+    void PutFloat(float f) { Put(&f, 1); }
+    void PutCurve(const Curve &c) {
+        PutInt(c.size());
+        PutFloat(c.x0);
+        PutFloat(c.x1);
+        if (c.size() > 0)
+            Put(&c.y[0], c.size());
+    }
+    bool Send(int fd) {
+        uint32_t length = data.size() - 4;
+        if (SystemEndianness() != LittleEndian)
+            SwapEndian(&length, 1);
+        memcpy(&data[0], &length, 4);
+        return WriteAll(fd, &data[0], data.size());
+    }
+};
+
+static MeasureGraph ToMeasureGraph(uint32_t measures)
+{
+    MeasureGraph graph;
+    if (measures & ServeSpatial)     graph.Request(MeasureSpatialStats);
+    if (measures & ServeSpectral)    graph.Request(MeasureSpectralStats);
+    if (measures & ServeRP)          graph.Request(MeasureRP);
+    if (measures & ServeRDF)         graph.Request(MeasureRDF);
+    if (measures & ServeAnisotropy)  graph.Request(MeasureAnisotropy);
+    if (measures & ServePeriodogram) graph.Request(MeasurePeriodogram);
+    return graph;
+}
+
+// Analyses share one context, which also keeps concurrent clients from
+// competing for the threads
+static std::mutex contextmutex;
+
+static void ServeClient(int fd, PsaContext *context)
+{
+    std::vector<float> points;
+    PsaResult r;
+    for (;;) {
+        uint32_t header[3];
+        if (!ReadValues(fd, header, 3))
+            break;
+        uint32_t length = header[0], measures = header[1], npoints = header[2];
+        bool valid = length >= 8 && length <= MaxRequest &&
+                     (length - 8) / 8 == npoints && (length - 8) % 8 == 0;
+        if (!valid) {
+            Reply reply;
+            reply.PutInt(PsaErrorArgument);
+            reply.Send(fd);
+            break;
+        }
+        points.resize(npoints * 2);
+        if (npoints > 0 && !ReadValues(fd, &points[0], npoints * 2))
+            break;
+        
+        MeasureGraph graph = ToMeasureGraph(measures);
+        int status;
+        {
+            std::lock_guard<std::mutex> lock(contextmutex);
+            status = context->Analyze(
+                npoints > 0 ? reinterpret_cast<const Point *>(&points[0]) : NULL,
+                npoints, graph, &r);
+        }
+        
+        Reply reply;
+        reply.PutInt(status);
+        if (status == PsaOK) {
+            Statistics s = r.stats;
+            NormalizeStatistics(&s, r.npoints);
+            reply.PutFloat(s.mindist);
+            reply.PutFloat(s.avgmindist);
+            reply.PutFloat(s.orientorder);
+            reply.PutFloat(s.effnyquist);
+            reply.PutFloat(s.oscillations);
+            reply.PutCurve(r.rp);
+            reply.PutCurve(r.rdf);
+            reply.PutCurve(r.ani);
+            int size = graph.Needs(MeasurePeriodogram) ? r.periodogram.size : 0;
+            reply.PutInt(size);
+            if (size > 0)
+                reply.Put(r.periodogram.periodogram, size * size);
+        }
+        if (!reply.Send(fd))
+            break;
+    }
+    close(fd);
+}
+
+// Slots of the clients served at once
+static std::mutex clientmutex;
+static std::condition_variable clientfree;
+static int nclients = 0;
+
+static void RunClient(int fd, PsaContext *context)
+{
+    ServeClient(fd, context);
+    std::lock_guard<std::mutex> lock(clientmutex);
+    --nclients;
+    clientfree.notify_one();
+}
+
+void Serve(const std::string &path, Config &config)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Socket path '" << path << "' is too long.\n";
+        exit(1);
+    }
+    strcpy(addr.sun_path, path.c_str());
+    
+    // Only a stale socket is replaced, never a file that happens to be there
+    struct stat st;
+    bool taken = false;
+    if (lstat(path.c_str(), &st) == 0) {
+        if (S_ISSOCK(st.st_mode))
+            unlink(path.c_str());
+        else
+            taken = true;
+    }
+    int fd = taken ? -1 : socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+        listen(fd, 64) < 0) {
+        std::cerr << "Cannot listen on '" << path << "'.\n";
+        exit(1);
+    }
+    std::cout << "Serving on '" << path << "'.\n" << std::flush;
+    
+    PsaContext context(config);
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(clientmutex);
+            while (nclients >= MaxClients)
+                clientfree.wait(lock);
+        }
+        int client = accept(fd, NULL, NULL);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            std::cerr << "Cannot accept connections on '" << path << "'.\n";
+            exit(1);
+        }
+        {
+            std::lock_guard<std::mutex> lock(clientmutex);
+            ++nclients;
+        }
+        std::thread(RunClient, client, &context).detach();
+    }
+}
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SERVE_H
+#define SERVE_H
+
+#include "config.h"
+#include <string>
+
+// Serves analyses over a Unix domain socket, keeping the configuration and
+// a PsaContext with its buffers and tables warm between requests. Clients
+// may keep a connection open for any number of requests and up to eight
+// clients are served at once, further ones wait for a free slot; their
+// analyses are run one after another, each using all threads. Requests are
+// limited to 64 MB, about 8M points. All values are little endian.
+//
+// Request:
+//   uint32  length          number of bytes that follow
+//   uint32  measures        bit mask of the Serve* flags below
+//   uint32  npoints
+//   float32 points[2*npoints]
+//
+// Reply:
+//   uint32  length          number of bytes that follow
+//   int32   status          PsaStatus; nothing follows unless PsaOK
+//   float32 stats[5]        G-MD, A-MD, BOO, E-Nyq., Osci. as printed by psa
+//   3x curve                RP, RDF and anisotropy, each as
+//     uint32  n             number of bins, 0 if not requested
+//     float32 x0, x1        range of the bins
+//     float32 y[n]
+//   uint32  size            periodogram size, 0 if not requested
+//   float32 periodogram[size*size]
+enum ServeMeasure {
+    ServeSpatial     = 1 << 0,
+    ServeSpectral    = 1 << 1,
+    ServeRP          = 1 << 2,
+    ServeRDF         = 1 << 3,
+    ServeAnisotropy  = 1 << 4,
+    ServePeriodogram = 1 << 5
+};
+
+void Serve(const std::string &path, Config &config);
+
+#endif  // SERVE_H
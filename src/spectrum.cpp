@@ -20,9 +20,12 @@
  */
 
 #include "spectrum.h"
+#include "profile.h"
 #include "util.h"
+#include <algorithm>
 #include <cmath>
 #include <string>
+#include <vector>
 
 #ifdef _OPENMP
 #include <omp.h>
@@ -36,39 +39,382 @@ Spectrum::Spectrum(int size) {
         ft[i] = 0;
 }
 
+Spectrum::Spectrum(const Spectrum &s) {
+    this->ft = NULL;
+    *this = s;
+}
+
 Spectrum& Spectrum::operator= (const Spectrum &s) {
+    if (this == &s) return *this;
     this->size = s.size;
-    if (this->ft) delete this->ft;
+    if (this->ft) delete[] this->ft;
     this->ft = new float[size * size * 2];
     memcpy(this->ft, s.ft, size * size * 2 * sizeof(float));
     return *this;
 }
 
+static inline void SpectrumColumn(Spectrum *spectrum, const Point *points,
+                                  const int npoints, const int x)
+{
+    const int size2 = spectrum->size / 2;
+    for (int y = 0; y < spectrum->size; ++y) {
+        float fx = 0.f, fy = 0.f;
+        float wx = x - size2;
+        float wy = y - size2;
+        for (int i = 0; i < npoints; ++i) {
+            float exp = -TWOPI * (wx * points[i].x + wy * points[i].y);
+            fx += cosf(exp);
+            fy += sinf(exp);
+        }
+        spectrum->ft[2*(x + y*spectrum->size)  ] = fx;
+        spectrum->ft[2*(x + y*spectrum->size)+1] = fy;
+    }
+}
+
 void Spectrum::PointSetSpectrum(Spectrum *spectrum, const PointSet &points,
                                 const int npoints)
 {
-    const int size2 = spectrum->size / 2;
+    PointSetSpectrum(spectrum, &points.points[0], npoints);
+}
+
+void Spectrum::PointSetSpectrum(Spectrum *spectrum, const Point *points,
+                                const int npoints)
+{
+    const double nfreqs = (double) spectrum->size * spectrum->size;
+    Profile::Count(CounterFrequencies, nfreqs);
+    Profile::Count(CounterTerms, nfreqs * npoints);
+#if defined(_OPENMP) && _OPENMP >= 201511
+    // When running as one of several concurrent analysis tasks, the columns
+    // become tasks of their own, which are picked up by any idle thread
+    if (omp_in_parallel()) {
+#pragma omp taskloop grainsize(1)
+        for (int x = 0; x < spectrum->size; ++x) {
+            ProfileScope scope("ft column");
+            SpectrumColumn(spectrum, points, npoints, x);
+        }
+        return;
+    }
+#endif
 #ifdef _OPENMP
 #pragma omp parallel
 #endif
 {
+    ProfileScope scope("ft worker");
 #ifdef _OPENMP
 #pragma omp for schedule(static)
 #endif
-    for (int x = 0; x < spectrum->size; ++x) {
-        for (int y = 0; y < spectrum->size; ++y) {
-            float fx = 0.f, fy = 0.f;
-            float wx = x - size2;
-            float wy = y - size2;
-            for (int i = 0; i < npoints; ++i) {
-                float exp = -TWOPI * (wx * points[i].x + wy * points[i].y);
-                fx += cosf(exp);
-                fy += sinf(exp);
+    for (int x = 0; x < spectrum->size; ++x)
+        SpectrumColumn(spectrum, points, npoints, x);
+}
+}
+
+// Phasors e^(-2 pi i w x) of point i along one axis for the n frequencies
+// w0 + k*step; integer frequencies are exact in float, so with a step of 1
+// these are the same phasors as for the integer grid
+static inline void SeparablePhasors(const float *coords, float w0, float step,
+                                    int n, int i, float *re, float *im)
+{
+    for (int w = 0; w < n; ++w) {
+        float exp = -TWOPI * ((w0 + w * step) * coords[i]);
+        re[i*n + w] = cosf(exp);
+        im[i*n + w] = sinf(exp);
+    }
+}
+
+// Adds the phasor products of n points to the column x of the accumulators
+static inline void SeparableColumn(int cols, int rows, int n, int x,
+                                   const float *xre, const float *xim,
+                                   const float *yre, const float *yim,
+                                   float *accre, float *accim)
+{
+    float *r = &accre[x*rows], *m = &accim[x*rows];
+    for (int i = 0; i < n; ++i) {
+        const float a = xre[i*cols + x], b = xim[i*cols + x];
+        const float *c = &yre[i*rows], *d = &yim[i*rows];
+        for (int y = 0; y < rows; ++y) {
+            r[y] += a * c[y] - b * d[y];
+            m[y] += a * d[y] + b * c[y];
+        }
+    }
+}
+
+void Spectrum::PointSetSpectrumSeparable(Spectrum *spectrum,
+                                         const Point *points,
+                                         const int npoints)
+{
+    PointSetSpectrumRows(spectrum->ft, spectrum->size, 0, spectrum->size,
+                         points, npoints);
+}
+
+// The phasor of a point factors into one for x and one for y, so the
+// spectrum is a complex matrix product of the per-axis phasors, computed
+// here for chunks of points to bound the memory. Adds the frequencies
+// (x0 + x*step, y0 + y*step) for x < cols and y < rows to the planar
+// accumulators, at x*rows + y.
+static void SeparableAdd(float x0, float y0, float step, int cols, int rows,
+                         const Point *points, const int npoints,
+                         float *accre, float *accim)
+{
+    const int chunk = SpectrumAccumulator::GroupSize;
+    std::vector<float> xs(chunk), ys(chunk);
+    std::vector<float> xre(chunk*cols), xim(chunk*cols);
+    std::vector<float> yre(chunk*rows), yim(chunk*rows);
+    for (int c = 0; c < npoints; c += chunk) {
+        const int n = std::min(chunk, npoints - c);
+        for (int i = 0; i < n; ++i) {
+            xs[i] = points[c+i].x;
+            ys[i] = points[c+i].y;
+        }
+#if defined(_OPENMP) && _OPENMP >= 201511
+        // Locals are firstprivate in tasks, so the buffers are shared
+        // explicitly
+        if (omp_in_parallel()) {
+#pragma omp taskloop shared(xs, ys, xre, xim, yre, yim)
+            for (int i = 0; i < n; ++i) {
+                SeparablePhasors(&xs[0], x0, step, cols, i, &xre[0], &xim[0]);
+                SeparablePhasors(&ys[0], y0, step, rows, i, &yre[0], &yim[0]);
             }
-            spectrum->ft[2*(x + y*spectrum->size)  ] = fx;
-            spectrum->ft[2*(x + y*spectrum->size)+1] = fy;
+            // A few blocks of columns per thread, each one task and one
+            // profile span
+            const int nblocks = std::min(cols, 4 * omp_get_num_threads());
+#pragma omp taskloop grainsize(1) shared(xre, xim, yre, yim, accre, accim)
+            for (int b = 0; b < nblocks; ++b) {
+                ProfileScope scope("ft columns");
+                for (int x = b * cols / nblocks; x < (b + 1) * cols / nblocks;
+                     ++x)
+                    SeparableColumn(cols, rows, n, x, &xre[0], &xim[0],
+                                    &yre[0], &yim[0], accre, accim);
+            }
+            continue;
+        }
+#endif
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+{
+        ProfileScope scope("ft worker");
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (int i = 0; i < n; ++i) {
+            SeparablePhasors(&xs[0], x0, step, cols, i, &xre[0], &xim[0]);
+            SeparablePhasors(&ys[0], y0, step, rows, i, &yre[0], &yim[0]);
         }
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (int x = 0; x < cols; ++x)
+            SeparableColumn(cols, rows, n, x, &xre[0], &xim[0], &yre[0],
+                            &yim[0], accre, accim);
+}
     }
 }
+
+void Spectrum::PointSetSpectrumRows(float *ft, int size, int y0, int rows,
+                                    const Point *points, const int npoints)
+{
+    const double nfreqs = (double) size * rows;
+    Profile::Count(CounterFrequencies, nfreqs);
+    Profile::Count(CounterTerms, nfreqs * npoints);
+    std::vector<float> accre(size*rows, 0.f), accim(size*rows, 0.f);
+    const int size2 = size / 2;
+    SeparableAdd(-size2, y0 - size2, 1.f, size, rows, points, npoints,
+                 &accre[0], &accim[0]);
+    for (int x = 0; x < size; ++x) {
+        for (int y = 0; y < rows; ++y) {
+            ft[2*(x + y*size)  ] = accre[x*rows + y];
+            ft[2*(x + y*size)+1] = accim[x*rows + y];
+        }
+    }
 }
 
+// Adds the terms of points first to last-1 for up to four frequencies, so
+// that each point is loaded once per block. The phase is reduced to a turn
+// before the sincos, which keeps it cheap and accurate for high frequencies.
+static inline void FrequencyBlock(const Point *freqs, const int nq,
+                                  const Point *points, const int first,
+                                  const int last, float *sums)
+{
+    float wx[4] = { 0.f }, wy[4] = { 0.f };
+    float re[4] = { 0.f }, im[4] = { 0.f };
+    for (int q = 0; q < nq; ++q) {
+        wx[q] = freqs[q].x;
+        wy[q] = freqs[q].y;
+    }
+    for (int i = first; i < last; ++i) {
+        const float x = points[i].x, y = points[i].y;
+        for (int q = 0; q < 4; ++q) {
+            float t = wx[q] * x + wy[q] * y;
+            t -= rintf(t);
+            re[q] += cosf(-TWOPI * t);
+            im[q] += sinf(-TWOPI * t);
+        }
+    }
+    for (int q = 0; q < nq; ++q) {
+        sums[2*q  ] = re[q];
+        sums[2*q+1] = im[q];
+    }
+}
+
+void Spectrum::PointSetFrequencies(const Point *freqs, const int nfreqs,
+                                   const Point *points, const int npoints,
+                                   float *ft)
+{
+    Profile::Count(CounterFrequencies, nfreqs);
+    Profile::Count(CounterTerms, (double) nfreqs * npoints);
+    
+    // Blocks of four frequencies, and blocks of points when there are too
+    // few of them to keep all threads busy. Each block of points sums into
+    // its own partial spectrum, which are added up at the end.
+    const int nqblocks = (nfreqs + 3) / 4;
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    int npblocks = std::max(1, 4 * threads / std::max(nqblocks, 1));
+    npblocks = std::min(npblocks, std::max(1, npoints / 1024));
+    const int pchunk = (npoints + npblocks - 1) / npblocks;
+    std::vector<float> partial(2 * 4 * nqblocks * npblocks, 0.f);
+    const int ntasks = nqblocks * npblocks;
+#if defined(_OPENMP) && _OPENMP >= 201511
+    if (omp_in_parallel()) {
+#pragma omp taskloop grainsize(1) shared(partial)
+        for (int t = 0; t < ntasks; ++t) {
+            const int qb = t % nqblocks, pb = t / nqblocks;
+            FrequencyBlock(&freqs[4*qb], std::min(4, nfreqs - 4*qb), points,
+                           pb * pchunk, std::min(npoints, (pb+1) * pchunk),
+                           &partial[8 * t]);
+        }
+    } else
+#endif
+    {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for (int t = 0; t < ntasks; ++t) {
+            const int qb = t % nqblocks, pb = t / nqblocks;
+            FrequencyBlock(&freqs[4*qb], std::min(4, nfreqs - 4*qb), points,
+                           pb * pchunk, std::min(npoints, (pb+1) * pchunk),
+                           &partial[8 * t]);
+        }
+    }
+    for (int i = 0; i < 2 * nfreqs; ++i) {
+        float sum = 0.f;
+        for (int pb = 0; pb < npblocks; ++pb)
+            sum += partial[8 * nqblocks * pb + i];
+        ft[i] = sum;
+    }
+}
+
+void Spectrum::PointSetPower(const Point *freqs, const int nfreqs,
+                             const Point *points, const int npoints,
+                             float *power)
+{
+    std::vector<float> ft(2 * nfreqs);
+    PointSetFrequencies(freqs, nfreqs, points, npoints, &ft[0]);
+    for (int i = 0; i < nfreqs; ++i)
+        power[i] = ft[2*i] * ft[2*i] + ft[2*i+1] * ft[2*i+1];
+}
+
+
+SpectrumAccumulator::SpectrumAccumulator(int size)
+    : size(size), npoints(0), re(size*size, 0.f), im(size*size, 0.f)
+{
+}
+
+void SpectrumAccumulator::Add(const Point *points, int npoints)
+{
+    const double nfreqs = (double) size * size;
+    Profile::Count(CounterFrequencies, nfreqs);
+    Profile::Count(CounterTerms, nfreqs * npoints);
+    const int size2 = size / 2;
+    SeparableAdd(-size2, -size2, 1.f, size, size, points, npoints,
+                 &re[0], &im[0]);
+    this->npoints += npoints;
+}
+
+void SpectrumAccumulator::Get(Spectrum *spectrum) const
+{
+    if (spectrum->size != size)
+        *spectrum = Spectrum(size);
+    for (int x = 0; x < size; ++x) {
+        for (int y = 0; y < size; ++y) {
+            spectrum->ft[2*(x + y*size)  ] = re[x*size + y];
+            spectrum->ft[2*(x + y*size)+1] = im[x*size + y];
+        }
+    }
+}
+
+
+SpectrumWindow::SpectrumWindow(float cx, float cy, float width, float height,
+                               float step)
+{
+    this->step = step;
+    nx = std::max(1, (int) floorf(width / step + 1e-4f) + 1);
+    ny = std::max(1, (int) floorf(height / step + 1e-4f) + 1);
+    x0 = cx - 0.5f * (nx - 1) * step;
+    y0 = cy - 0.5f * (ny - 1) * step;
+    ft.assign(2 * nx * ny, 0.f);
+}
+
+static inline void WindowRow(SpectrumWindow *window, const Point *points,
+                             const int npoints, const int j)
+{
+    const float wy = window->FrequencyY(j);
+    for (int i = 0; i < window->nx; ++i) {
+        const float wx = window->FrequencyX(i);
+        float fx = 0.f, fy = 0.f;
+        for (int k = 0; k < npoints; ++k) {
+            // Reduced to a turn as in FrequencyBlock()
+            float t = wx * points[k].x + wy * points[k].y;
+            t -= rintf(t);
+            fx += cosf(-TWOPI * t);
+            fy += sinf(-TWOPI * t);
+        }
+        window->ft[2*(i + j*window->nx)  ] = fx;
+        window->ft[2*(i + j*window->nx)+1] = fy;
+    }
+}
+
+void SpectrumWindow::PointSetSpectrum(SpectrumWindow *window,
+                                      const Point *points, const int npoints,
+                                      int engine)
+{
+    const int nx = window->nx, ny = window->ny;
+    const double nfreqs = (double) nx * ny;
+    Profile::Count(CounterFrequencies, nfreqs);
+    Profile::Count(CounterTerms, nfreqs * npoints);
+    window->ft.assign(2 * nx * ny, 0.f);
+    
+    // A phasor costs about as much as five products, and the direct engine
+    // takes one per frequency where the separable one takes one per row and
+    // column plus four products per frequency, which pays off once
+    // 5 nfreqs > 5 (nx + ny) + 4 nfreqs
+    if (engine == EngineAuto)
+        engine = (nfreqs > 5.0 * (nx + ny)) ? FTSeparable : FTDirect;
+    if (engine == FTSeparable) {
+        std::vector<float> accre(nx*ny, 0.f), accim(nx*ny, 0.f);
+        SeparableAdd(window->x0, window->y0, window->step, nx, ny, points,
+                     npoints, &accre[0], &accim[0]);
+        for (int x = 0; x < nx; ++x) {
+            for (int y = 0; y < ny; ++y) {
+                window->ft[2*(x + y*nx)  ] = accre[x*ny + y];
+                window->ft[2*(x + y*nx)+1] = accim[x*ny + y];
+            }
+        }
+        return;
+    }
+#if defined(_OPENMP) && _OPENMP >= 201511
+    if (omp_in_parallel()) {
+#pragma omp taskloop grainsize(1)
+        for (int j = 0; j < ny; ++j)
+            WindowRow(window, points, npoints, j);
+        return;
+    }
+#endif
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int j = 0; j < ny; ++j)
+        WindowRow(window, points, npoints, j);
+}
@@ -22,7 +22,9 @@
 #ifndef SPECTRUM_H
 #define SPECTRUM_H
 
+#include "engine.h"
 #include "point.h"
+#include <vector>
 
 class Spectrum
 {
@@ -32,11 +34,84 @@ public:
     
     Spectrum() { ft = NULL; size = 0; }
     Spectrum(int size);
+    Spectrum(const Spectrum &s);
     Spectrum& operator= (const Spectrum &s);
     ~Spectrum() { if (ft) delete[] ft; }
 
     static void PointSetSpectrum(Spectrum *spectrum, const PointSet &points,
                                  const int npoints);
+    static void PointSetSpectrum(Spectrum *spectrum, const Point *points,
+                                 const int npoints);
+    // Same spectrum via separable per-axis phasors, no sincos per term
+    static void PointSetSpectrumSeparable(Spectrum *spectrum,
+                                          const Point *points,
+                                          const int npoints);
+    // Rows y0 to y0+rows-1 of the spectrum of the given size, stored in ft
+    // with the layout of Spectrum::ft, i.e. 2*size*rows floats
+    static void PointSetSpectrumRows(float *ft, int size, int y0, int rows,
+                                     const Point *points, const int npoints);
+    
+    // Spectrum at a list of frequency vectors (x, y), which need not be
+    // integer, e.g. lattice peaks or directions prone to aliasing, without
+    // a grid. Stores the complex value of freqs[i] at ft[2*i] and
+    // ft[2*i+1], or |F|^2 at power[i].
+    static void PointSetFrequencies(const Point *freqs, const int nfreqs,
+                                    const Point *points, const int npoints,
+                                    float *ft);
+    static void PointSetPower(const Point *freqs, const int nfreqs,
+                              const Point *points, const int npoints,
+                              float *power);
+};
+
+// Spectrum at the frequencies (x0 + i*step, y0 + j*step) for i < nx and
+// j < ny, e.g. a zoomed region around a peak or one beyond the frange of the
+// grid, at the cost of that region only. Between integer frequencies the
+// spectrum of a set on the unit torus also holds the response of the edges
+// of the unit square. Stored like Spectrum::ft, with nx values per row.
+class SpectrumWindow
+{
+public:
+    float x0, y0, step;
+    int nx, ny;
+    std::vector<float> ft;
+    
+    SpectrumWindow() : x0(0.f), y0(0.f), step(1.f), nx(0), ny(0) {}
+    // Frequencies from cx - width/2 to cx + width/2 and likewise for y
+    SpectrumWindow(float cx, float cy, float width, float height, float step);
+    
+    float FrequencyX(int i) const { return x0 + i * step; }
+    float FrequencyY(int j) const { return y0 + j * step; }
+    float Power(int i, int j) const {
+        const float u = ft[2*(i + j*nx)], v = ft[2*(i + j*nx)+1];
+        return u*u + v*v;
+    }
+    
+    // The engine is an FTEngine, or EngineAuto for the faster one for the
+    // shape of the window
+    static void PointSetSpectrum(SpectrumWindow *window, const Point *points,
+                                 const int npoints, int engine = EngineAuto);
+};
+
+// Spectrum summed over blocks of points, e.g. of a set that is read in parts
+// because it does not fit in memory. The sums are kept in a planar layout
+// until Get().
+class SpectrumAccumulator
+{
+public:
+    SpectrumAccumulator(int size);
+    
+    // Points are summed in groups of this size, so blocks of whole groups
+    // give the same sums as the separable spectrum of all points at once
+    static const int GroupSize = 256;
+    
+    void Add(const Point *points, int npoints);
+    long NumPoints() const { return npoints; }
+    void Get(Spectrum *spectrum) const;
+
+private:
+    int size;
+    long npoints;
+    std::vector<float> re, im;
 };
 
 #endif  // SPECTRUM_H
@@ -25,6 +25,10 @@
 #include "delaunay.h"
 #endif
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 
 static float Integrate(const Curve &c, float x0, float x1) {
     bool negate = false;
@@ -106,7 +110,7 @@ static inline float BlackmanWindow(float x, float xlim) {
     return (x > xlim) ? 0.f : 0.43f + 0.5f * cosf(PI*x / xlim) + 0.08f * cosf(TWOPI*x / xlim);
 }
 
-static void RDFtoRP(const Curve &rdf, int npoints, Curve *rp) {
+void RDFtoRP(const Curve &rdf, int npoints, Curve *rp) {
     const float wstep = 1.f / sqrtf(npoints);
     Curve tmp(rdf);
     for (int i = 0; i < rp->size(); ++i) {
@@ -122,8 +126,52 @@ static void RDFtoRP(const Curve &rdf, int npoints, Curve *rp) {
     }
 }
 
+// One bin of RDFtoRP(); the window vanishes beyond wndsize, so the Bessel
+// function is only evaluated inside it
+static inline float HankelBin(const Curve &rdf, int npoints, float u0,
+                              Curve *tmp)
+{
+    const float wstep = 1.f / sqrtf(npoints);
+    const float u = TWOPI * u0;
+    const float wndsize = rdf.x1 * std::min(0.5f, std::max(0.2f, 4.f * u0 * wstep));
+    for (int j = 0; j < tmp->size(); ++j) {
+        float x = rdf.ToX(j);
+        (*tmp)[j] = (x > wndsize) ? 0.f :
+            (rdf[j] - 1) * j0f(u*x) * x * BlackmanWindow(x, wndsize);
+    }
+    return fabsf(1.f + TWOPI * Integrate(*tmp) * npoints);
+}
+
+void RDFtoRPWindowed(const Curve &rdf, int npoints, Curve *rp) {
+#if defined(_OPENMP) && _OPENMP >= 201511
+    if (omp_in_parallel()) {
+        // Blocks of bins, so that every task allocates one scratch curve
+        const int block = 16;
+#pragma omp taskloop
+        for (int b = 0; b < rp->size(); b += block) {
+            Curve tmp(rdf);
+            const int end = std::min(b + block, rp->size());
+            for (int i = b; i < end; ++i)
+                (*rp)[i] = HankelBin(rdf, npoints, rp->ToX(i), &tmp);
+        }
+        return;
+    }
+#endif
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+{
+    Curve tmp(rdf);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+    for (int i = 0; i < rp->size(); ++i)
+        (*rp)[i] = HankelBin(rdf, npoints, rp->ToX(i), &tmp);
+}
+}
+
 #ifndef PSA_HAS_CGAL
-static void Distances(const PointSet &points, int npoints,
+static void Distances(const Point *points, int npoints,
                       float *mindist, float *avgmindist)
 {
     *mindist = FLT_MAX;
@@ -139,12 +187,24 @@ static void Distances(const PointSet &points, int npoints,
         *avgmindist += sqrtf(localmd);
     }
     *mindist = sqrtf(*mindist);
-    *avgmindist /= points.size();
+    *avgmindist /= npoints;
 }
 #endif
 
 
+void NormalizeStatistics(Statistics *stats, int npoints) {
+    const float fnorm = 2.f / sqrtf(npoints);
+    const float rnorm = 1.f / sqrtf(2.f / (SQRT3 * npoints));
+    stats->mindist *= rnorm;
+    stats->avgmindist *= rnorm;
+    stats->effnyquist *= fnorm;
+}
+
 void SpatialStatistics(const PointSet &points, int npoints, Statistics *stats) {
+    SpatialStatistics(&points.points[0], npoints, stats);
+}
+
+void SpatialStatistics(const Point *points, int npoints, Statistics *stats) {
 #ifdef PSA_HAS_CGAL
     std::vector<Point_2> cgalPoints(npoints);
     for (int i = 0; i < npoints; ++i)
@@ -164,29 +224,59 @@ void SpectralStatistics(const PointSet &points, int npoints, Statistics *stats)
 }
 
 void SpectralStatistics(std::vector<PointSet> &sets, int npoints, Statistics *stats) {
-    // We need the full radial power spectrum, so for performance reasons, we
-    // derive the radial power spectrum directly from full RDFs here
     const int nsets = (int) sets.size();
-    const int nbins = 100 * sqrtf(npoints);
-    Curve avgrp(nbins, 0, 0.5f * npoints);
-    Curve rdf(nbins, 0, 0.5f);
-    Curve rp(nbins, 0, 0.5f * npoints);
+    SpectralAverage avg(npoints);
     
     if (nsets > 1) PrintProgress("Stats", 0);
     for (int i = 0; i < nsets; ++i) {
-        rdf.SetZero();
-        sets[i].RDF(&rdf);
-        
-        rp.SetZero();
-        RDFtoRP(rdf, npoints, &rp);
-        avgrp.Accumulate(rp);
-        
+        avg.Add(sets[i]);
         if (nsets > 1) PrintProgress("Stats", (i+1) / (float) nsets);
     }
-    avgrp.Divide(sets.size());
     if (nsets > 1) std::cout << std::endl;
     
-    stats->effnyquist = EffectiveNyquist(avgrp, npoints);
-    stats->oscillations = OscillationsMetric(avgrp, npoints);
+    avg.GetStatistics(stats);
+}
+
+
+// We need the full radial power spectrum, so for performance reasons, we
+// derive the radial power spectrum directly from full RDFs here
+SpectralAverage::SpectralAverage(int npoints)
+    : avgrp(100 * sqrtf(npoints), 0, 0.5f * npoints),
+      rdf(100 * sqrtf(npoints), 0, 0.5f),
+      rp(100 * sqrtf(npoints), 0, 0.5f * npoints),
+      npoints(npoints), nsets(0), hankel(HankelDirect)
+{
+}
+
+void SpectralAverage::Add(const PointSet &points) {
+    rdf.SetZero();
+    points.RDF(&rdf);
+    AddRDF(rdf);
 }
 
+void SpectralAverage::AddRDF(const Curve &rdf) {
+    rp.SetZero();
+    if (hankel == HankelWindowed)
+        RDFtoRPWindowed(rdf, npoints, &rp);
+    else
+        RDFtoRP(rdf, npoints, &rp);
+    avgrp.Accumulate(rp);
+    ++nsets;
+}
+
+void SpectralAverage::Reset() {
+    avgrp.SetZero();
+    nsets = 0;
+}
+
+void SpectralAverage::GetStatistics(Statistics *stats) const {
+    Curve rp(avgrp);
+    if (nsets > 0)
+        rp.Divide(nsets);
+    RPStatistics(rp, npoints, stats);
+}
+
+void RPStatistics(const Curve &rp, int npoints, Statistics *stats) {
+    stats->effnyquist = EffectiveNyquist(rp, npoints);
+    stats->oscillations = OscillationsMetric(rp, npoints);
+}
@@ -23,6 +23,7 @@
 #define STATISTICS_H
 
 #include "curve.h"
+#include "engine.h"
 #include "point.h"
 #include <cassert>
 
@@ -47,7 +48,39 @@ struct Statistics {
     }
 };
 
+// Radial power spectrum derived from full RDFs and averaged over any number
+// of sets, from which the spectral statistics are computed
+class SpectralAverage {
+    Curve avgrp, rdf, rp;
+    int npoints, nsets;
+    int hankel;
+public:
+    SpectralAverage(int npoints);
+    void SetHankel(int engine) { hankel = engine; }  // HankelEngine
+    void Add(const PointSet &points);
+    void AddRDF(const Curve &rdf);
+    void GetStatistics(Statistics *stats) const;
+    void Reset();
+    
+    // Parameters of the full RDF expected by AddRDF()
+    const Curve &RDFLayout() const { return rdf; }
+    int NumPoints() const { return npoints; }
+};
+
+// Scales distances and frequencies to the units of the output, relative to
+// the hexagonal lattice with the same number of points
+void NormalizeStatistics(Statistics *stats, int npoints);
+
+// Hankel transform of a full RDF into a radial power spectrum; the windowed
+// variant gives the same result, computing the bins in parallel
+void RDFtoRP(const Curve &rdf, int npoints, Curve *rp);
+void RDFtoRPWindowed(const Curve &rdf, int npoints, Curve *rp);
+
+// Spectral statistics of a radial power spectrum
+void RPStatistics(const Curve &rp, int npoints, Statistics *stats);
+
 void SpatialStatistics(const PointSet &points, int npoints, Statistics *stats);
+void SpatialStatistics(const Point *points, int npoints, Statistics *stats);
 void SpectralStatistics(const PointSet &points, int npoints, Statistics *stats);
 void SpectralStatistics(std::vector<PointSet> &sets, int npoints, Statistics *stats);
 
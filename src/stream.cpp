@@ -0,0 +1,114 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "stream.h"
+#include "profile.h"
+#include <algorithm>
+#include <cctype>
+
+
+PointSetStream::PointSetStream()
+    : fp(NULL), format(TXT), capacity(1),
+      done(true), failed(false), closing(false)
+{
+}
+
+void PointSetStream::Open(FILE *fp, Format format, int capacity)
+{
+    Close();
+    this->fp = fp;
+    this->format = format;
+    this->capacity = std::max(1, capacity);
+    done = failed = closing = false;
+    reader = std::thread(&PointSetStream::Run, this);
+}
+
+void PointSetStream::Run()
+{
+    Profile::NameThread("reader");
+    for (;;) {
+        PointSet set;
+        bool ok;
+        {
+            ProfileScope scope("read");
+            ok = PointSet::ReadFrame(fp, format == RPS, &set);
+        }
+        
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!ok) {
+            // A clean end of input leaves nothing but whitespace behind
+            failed = !feof(fp) || ferror(fp) || !set.points.empty();
+            done = true;
+            notEmpty.notify_all();
+            return;
+        }
+        while ((int) queue.size() >= capacity && !closing)
+            notFull.wait(lock);
+        if (closing)
+            return;
+        queue.push_back(PointSet());
+        queue.back().points.swap(set.points);
+        notEmpty.notify_one();
+    }
+}
+
+bool PointSetStream::Next(PointSet *set)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (queue.empty() && !done)
+        notEmpty.wait(lock);
+    if (queue.empty())
+        return false;
+    set->points.swap(queue.front().points);
+    queue.pop_front();
+    notFull.notify_one();
+    return true;
+}
+
+void PointSetStream::Close()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        closing = true;
+        notFull.notify_all();
+    }
+    // A reader blocked in fread() only returns once the writer closes the
+    // pipe, which is the expected way for a stream to end anyway
+    if (reader.joinable())
+        reader.join();
+    queue.clear();
+    fp = NULL;
+}
+
+bool PointSetStream::ParseFormat(const std::string &name, Format *format)
+{
+    std::string s = name;
+    std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+    if (!s.empty() && s[0] == '.')
+        s = s.substr(1);
+    if (s == "txt")
+        *format = TXT;
+    else if (s == "rps")
+        *format = RPS;
+    else
+        return false;
+    return true;
+}
@@ -0,0 +1,65 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "point.h"
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// Reads a sequence of point sets from a pipe on a background thread, so that
+// a generator and the analysis can run concurrently. At most 'capacity' sets
+// are buffered; the reader blocks while the consumer falls behind.
+class PointSetStream
+{
+public:
+    enum Format { TXT, RPS };
+    
+    PointSetStream();
+    ~PointSetStream() { Close(); }
+    
+    void Open(FILE *fp, Format format, int capacity = 4);
+    bool Next(PointSet *set);
+    void Close();
+    bool Failed() const { return failed; }
+    
+    static bool ParseFormat(const std::string &name, Format *format);
+    
+private:
+    PointSetStream(const PointSetStream &);
+    PointSetStream& operator= (const PointSetStream &);
+    void Run();
+    
+    FILE *fp;
+    Format format;
+    int capacity;
+    bool done, failed, closing;
+    std::deque<PointSet> queue;
+    std::mutex mutex;
+    std::condition_variable notEmpty, notFull;
+    std::thread reader;
+};
+
+#endif  // STREAM_H
@@ -0,0 +1,154 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tiled.h"
+#include "profile.h"
+#include "spectrum.h"
+#include "util.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+
+TiledSpectrum::TiledSpectrum(int size, int bandrows, int downsample)
+    : size(size), downsample(std::max(downsample, 1))
+{
+    bandrows = std::min(std::max(bandrows, 1), size);
+    this->bandrows = std::max(bandrows / this->downsample, 1) *
+                     this->downsample;
+}
+
+double TiledSpectrum::GridBytes(int size)
+{
+    return (double) size * size * (2 + 1 + 1) * sizeof(float);
+}
+
+int TiledSpectrum::BandRows(int size, double bytes)
+{
+    // A band row takes the spectrum and its accumulators, 4 floats per
+    // frequency; the phasors of the x axis are needed for any band
+    const double phasors = 2. * 256 * size * sizeof(float);
+    const double row = 4. * size * sizeof(float);
+    return (int) std::min((double) size, std::max(1., (bytes - phasors) / row));
+}
+
+bool TiledSpectrum::Compute(const Point *points, int npoints, Curve *rp,
+                            Curve *ani, ImageSink *sink)
+{
+    const int size2 = size / 2;
+    const int nrings = rp->size();
+    const float inv = 1.f / npoints;
+    const int width = ImageSize();
+    bool ok = !sink || sink->Begin(width, width);
+    
+    // Count, mean and sum of squared deviations of the power in each ring,
+    // for all bands so far and for the current one
+    std::vector<double> count(nrings, 0.), mean(nrings, 0.), m2(nrings, 0.);
+    std::vector<double> bcount(nrings), bsum(nrings), bm2(nrings);
+    std::vector<float> band(2 * size * bandrows);
+    std::vector<float> row(width);
+    
+    const int nbands = (size + bandrows - 1) / bandrows;
+    for (int b = nbands - 1; b >= 0; --b) {
+        const int y0 = b * bandrows;
+        const int rows = std::min(bandrows, size - y0);
+        {
+            ProfileScope scope("ft band");
+            Spectrum::PointSetSpectrumRows(&band[0], size, y0, rows,
+                                           points, npoints);
+        }
+        ProfileScope scope("band fold");
+        
+        // Periodogram in place, power k is written over the spectrum
+        // components 2k and 2k+1, which have been read by then
+        float *power = &band[0];
+        for (int k = 0; k < size * rows; ++k) {
+            const float u = band[2*k], v = band[2*k+1];
+            power[k] = (u*u + v*v) * inv;
+        }
+        
+        // Ring statistics of the band, merged into the running ones
+        std::fill(bcount.begin(), bcount.end(), 0.);
+        std::fill(bsum.begin(), bsum.end(), 0.);
+        std::fill(bm2.begin(), bm2.end(), 0.);
+        for (int pass = 0; pass < 2; ++pass) {
+            for (int y = 0; y < rows; ++y) {
+                const int cy = abs(y0 + y - size2);
+                for (int x = 0; x < size; ++x) {
+                    const int cx = abs(x - size2);
+                    const int i = rp->ToIndex(sqrtf(cx*cx + cy*cy));
+                    if (i >= nrings)
+                        continue;
+                    const float p = power[x + y*size];
+                    if (pass == 0) {
+                        bcount[i] += 1.;
+                        bsum[i] += p;
+                    } else {
+                        const double d = p - bsum[i] / bcount[i];
+                        bm2[i] += d * d;
+                    }
+                }
+            }
+        }
+        for (int i = 0; i < nrings; ++i) {
+            if (bcount[i] == 0.)
+                continue;
+            const double n = count[i] + bcount[i];
+            const double d = bsum[i] / bcount[i] - mean[i];
+            mean[i] += d * bcount[i] / n;
+            m2[i] += bm2[i] + d * d * count[i] * bcount[i] / n;
+            count[i] = n;
+        }
+        
+        // Image rows of the band from the top, each the tone-mapped average
+        // power of downsample x downsample boxes
+        for (int j = (y0 + rows - 1) / downsample;
+             sink && ok && j >= y0 / downsample; --j) {
+            const int ylo = j * downsample - y0;
+            const int yhi = std::min(ylo + downsample, rows);
+            for (int xo = 0; xo < width; ++xo) {
+                const int xlo = xo * downsample;
+                const int xhi = std::min(xlo + downsample, size);
+                float sum = 0.f;
+                for (int y = ylo; y < yhi; ++y)
+                    for (int x = xlo; x < xhi; ++x)
+                        sum += power[x + y*size];
+                row[xo] = Image::ToneMapValue(sum / ((yhi-ylo) * (xhi-xlo)),
+                                              true);
+            }
+            ok = sink->Row(&row[0]);
+        }
+    }
+    if (sink && ok)
+        ok = sink->End();
+    
+    // Normalized as in Periodogram::RadialPower and Anisotropy
+    for (int i = 0; i < nrings; ++i)
+        (*rp)[i] = (count[i] > 0.) ? mean[i] : 0.f;
+    if (ani) {
+        for (int i = 0; i < nrings; ++i) {
+            float var = (count[i] > 1.) ? m2[i] / (count[i] - 1.) : 0.f;
+            float sqpow = (*rp)[i] * (*rp)[i];
+            (*ani)[i] = Decibel((sqpow > 0) ? var / sqpow : 1);
+        }
+    }
+    return ok;
+}
@@ -0,0 +1,60 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILED_H
+#define TILED_H
+
+#include "curve.h"
+#include "image.h"
+#include "point.h"
+
+// RP, ANI and spectrum image of sets whose full frequency grid does not fit
+// in memory. The spectrum is computed in bands of rows from the top. Each
+// band is folded into running means and variances of the rings and into the
+// image rows before the next one is computed, so only a band of the spectrum
+// is held at any time. The image may be downsampled by averaging the power
+// over boxes of frequencies before the tone mapping.
+class TiledSpectrum
+{
+public:
+    // Spectrum of the given size as in Spectrum, in bands of at most
+    // bandrows rows, rounded down to a multiple of the downsampling factor
+    TiledSpectrum(int size, int bandrows, int downsample = 1);
+    
+    // Bytes taken by the spectrum, periodogram and image of the full grid
+    static double GridBytes(int size);
+    // Largest number of band rows whose buffers fit in the given bytes
+    static int BandRows(int size, double bytes);
+    
+    // Folds the periodogram of the points, divided by npoints as in
+    // PsaResult, into rp, whose bins set the rings, into ani, which may be
+    // NULL or has the parameters of rp, and into the rows of the image sent
+    // to sink, which may be NULL. Returns false if the sink fails.
+    bool Compute(const Point *points, int npoints, Curve *rp, Curve *ani,
+                 ImageSink *sink);
+    
+    int ImageSize() const { return (size + downsample - 1) / downsample; }
+
+private:
+    int size, bandrows, downsample;
+};
+
+#endif  // TILED_H
@@ -0,0 +1,308 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tune.h"
+#include "generate.h"
+#include "profile.h"
+#include "rdfsample.h"
+#include "statistics.h"
+#include "util.h"
+#include <condition_variable>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+// Largest sets and spectra the candidates are timed on, which keeps tuning
+// to a few seconds per bucket; the times at larger sizes are extrapolated
+static const int TuneMaxPoints = 4096;
+static const int TuneMaxFTPoints = 1024;
+static const int TuneMaxFTSize = 128;
+// Timed runs of each candidate after a warm-up run
+static const int TuneRuns = 3;
+
+// Choices by key, and the keys being timed by some thread
+static std::mutex tunemutex;
+static std::condition_variable tunedone;
+static std::map<std::string, Engines> tuned;
+static std::set<std::string> tuning;
+
+// Nearest power of two
+static int Bucket(int n)
+{
+    int b = 1;
+    while (b * SQRT2 < n)
+        b *= 2;
+    return b;
+}
+
+static std::string HostName()
+{
+#if defined(_WIN32) || defined(_WIN64) || defined(_MSC_VER)
+    const char *name = getenv("COMPUTERNAME");
+    return name ? name : "unknown";
+#else
+    char name[256];
+    if (gethostname(name, sizeof(name)) != 0)
+        return "unknown";
+    name[sizeof(name) - 1] = '\0';
+    return name;
+#endif
+}
+
+// Fastest of the runs of f. The warm-up run pages in the buffers and starts
+// the threads, which would otherwise count against the first candidate.
+template <class F>
+static double Time(F f)
+{
+    f();
+    double best = HUGE_VAL;
+    for (int i = 0; i < TuneRuns; ++i) {
+        double t = Profile::Now();
+        f();
+        best = std::min(best, Profile::Now() - t);
+    }
+    return best;
+}
+
+// Time of run(n, size). Sizes beyond the limits are extrapolated along each
+// by the power law through the times at the limit and at half of it, as the
+// candidates of a stage scale differently and the faster one at the limit
+// need not stay ahead.
+template <class F>
+static double Predict(F run, int n, int nmax, int size, int sizemax)
+{
+    const int n0 = std::min(n, nmax), size0 = std::min(size, sizemax);
+    const double t = Time([&]() { run(n0, size0); });
+    double scale = 1;
+    if (n > n0) {
+        double half = Time([&]() { run(n0 / 2, size0); });
+        scale *= pow(double(n) / n0, std::max(0.0, log2(t / half)));
+    }
+    if (size > size0) {
+        double half = Time([&]() { run(n0, size0 / 2); });
+        scale *= pow(double(size) / size0, std::max(0.0, log2(t / half)));
+    }
+    return t * scale;
+}
+
+// Times the candidates of every stage on sets of npoints points and a
+// spectrum of ftsize, extrapolated beyond the limits above
+static Engines Measure(const Config &config, int npoints, int ftsize)
+{
+    ProfileScope scope("tune");
+    std::map<int, PointSet> sets;
+    // Generated in the warm-up runs of Time()
+    auto points = [&](int n) -> const Point * {
+        PointSet &set = sets[n];
+        if (set.size() != n)
+            GeneratePoints(GenerateJitter, n, 1, &set);
+        return &set.points[0];
+    };
+    Engines best;
+    
+    auto direct = [&](int n, int size) {
+        Spectrum s(std::max(2, 2 * size));
+        Spectrum::PointSetSpectrum(&s, points(n), n);
+    };
+    auto separable = [&](int n, int size) {
+        Spectrum s(std::max(2, 2 * size));
+        Spectrum::PointSetSpectrumSeparable(&s, points(n), n);
+    };
+    const int ftmax = TuneMaxFTSize / 2;
+    double tdirect = Predict(direct, npoints, TuneMaxFTPoints, ftsize, ftmax);
+    double tseparable = Predict(separable, npoints, TuneMaxFTPoints, ftsize,
+                                ftmax);
+    best.ft = (tseparable < tdirect) ? FTSeparable : FTDirect;
+    
+    // The RDFs of an analysis with spectral statistics
+    auto rdf = [&](int n, int cells) {
+        const float rnorm = 1.f / sqrtf(2.f / (SQRT3 * n));
+        Curve rdf(config.rbinsize * n, 0, config.rrange / rnorm);
+        Curve fullrdf = SpectralAverage(n).RDFLayout();
+        std::vector<Curve *> rdfs;
+        rdfs.push_back(&rdf);
+        rdfs.push_back(&fullrdf);
+        if (cells)
+            PointSet::RDFCellList(points(n), n, rdfs);
+        else
+            PointSet::RDF(points(n), n, rdfs);
+    };
+    double pairs = Predict([&](int n, int) { rdf(n, 0); }, npoints,
+                           TuneMaxPoints, 1, 1);
+    double cells = Predict([&](int n, int) { rdf(n, 1); }, npoints,
+                           TuneMaxPoints, 1, 1);
+    best.rdf = (cells < pairs) ? RDFCells : RDFPairs;
+    
+    // A fraction of the bins over the whole frequency range suffices; the
+    // values of the RDF do not matter
+    auto hankel = [&](int n, int windowed) {
+        SpectralAverage spectral(n);
+        const Curve &fullrdf = spectral.RDFLayout();
+        Curve rp(fullrdf.size() / 8 + 1, 0, 0.5f * n);
+        if (windowed)
+            RDFtoRPWindowed(fullrdf, n, &rp);
+        else
+            RDFtoRP(fullrdf, n, &rp);
+    };
+    tdirect = Predict([&](int n, int) { hankel(n, 0); }, npoints,
+                      TuneMaxPoints, 1, 1);
+    double windowed = Predict([&](int n, int) { hankel(n, 1); }, npoints,
+                              TuneMaxPoints, 1, 1);
+    best.hankel = (windowed < tdirect) ? HankelWindowed : HankelDirect;
+    return best;
+}
+
+// Entries of the cache file are lines of the key followed by the engines;
+// later entries take precedence
+static bool LoadEntry(const std::string &fname, const std::string &key,
+                      Engines *engines)
+{
+    std::ifstream file(fname.c_str());
+    std::string line;
+    bool found = false;
+    while (getline(file, line)) {
+        size_t sep = line.rfind(' ');
+        if (line.empty() || line[0] == '#' || sep == std::string::npos)
+            continue;
+        Engines entry = ReferenceEngines();
+        if (line.substr(0, sep) == key &&
+            ParseEngines(line.substr(sep + 1), &entry)) {
+            *engines = entry;
+            found = true;
+        }
+    }
+    return found;
+}
+
+static void StoreEntry(const std::string &fname, const std::string &key,
+                       const Engines &engines)
+{
+    bool exists = std::ifstream(fname.c_str()).good();
+    std::ofstream file(fname.c_str(), std::ios::app);
+    if (!file)
+        return;
+    if (!exists)
+        file << "# Engines chosen by the autotuner of psa for host, threads, "
+                "points, spectrum\n# size, RDF range and RDF bin size. "
+                "Remove lines to tune again.\n";
+    file << key << " " << EnginesString(engines) << "\n";
+}
+
+Engines TuneEngines(const Config &config, int npoints)
+{
+    Engines engines = config.engines;
+    if (engines.ft != EngineAuto && engines.rdf != EngineAuto &&
+        engines.hankel != EngineAuto)
+        return engines;
+    
+    const float fnorm = 2.f / sqrtf(npoints);
+    const int ftsize = config.frange / fnorm;
+    const int nbucket = Bucket(npoints);
+    const int ftbucket = Bucket(ftsize);
+    int nthreads = 1;
+#ifdef _OPENMP
+    nthreads = omp_get_max_threads();
+#endif
+    std::ostringstream oss;
+    oss << HostName() << " " << nthreads << " " << nbucket << " " << ftbucket
+        << " " << config.rrange << " " << config.rbinsize;
+    const std::string key = oss.str();
+    
+    // Timing takes seconds, so other keys are looked up and tuned meanwhile;
+    // a thread that needs the same key waits for the choice
+    Engines best;
+    std::unique_lock<std::mutex> lock(tunemutex);
+    while (tuning.count(key))
+        tunedone.wait(lock);
+    std::map<std::string, Engines>::const_iterator it = tuned.find(key);
+    if (it != tuned.end()) {
+        best = it->second;
+    } else {
+        tuning.insert(key);
+        lock.unlock();
+        bool found = false;
+        try {
+            found = !config.tunecache.empty() &&
+                    LoadEntry(config.tunecache, key, &best);
+            if (!found)
+                best = Measure(config, nbucket, ftbucket);
+        } catch (...) {
+            lock.lock();
+            tuning.erase(key);
+            tunedone.notify_all();
+            throw;
+        }
+        lock.lock();
+        if (!found && !config.tunecache.empty())
+            StoreEntry(config.tunecache, key, best);
+        tuned[key] = best;
+        tuning.erase(key);
+        tunedone.notify_all();
+    }
+    lock.unlock();
+    if (engines.ft == EngineAuto) engines.ft = best.ft;
+    if (engines.rdf == EngineAuto) engines.rdf = best.rdf;
+    if (engines.hankel == EngineAuto) engines.hankel = best.hankel;
+    return engines;
+}
+
+void EngineSpectrum(const Engines &engines, Spectrum *spectrum,
+                    const Point *points, int npoints)
+{
+    if (engines.ft == FTSeparable)
+        Spectrum::PointSetSpectrumSeparable(spectrum, points, npoints);
+    else
+        Spectrum::PointSetSpectrum(spectrum, points, npoints);
+}
+
+void EngineRDF(const Engines &engines, const Point *points, int npoints,
+               const std::vector<Curve *> &rdfs)
+{
+    if (engines.rdf == RDFCells)
+        PointSet::RDFCellList(points, npoints, rdfs);
+    else
+        PointSet::RDF(points, npoints, rdfs);
+}
+
+void ConfigRDF(const Config &config, const Engines &engines,
+               const Point *points, int npoints,
+               const std::vector<Curve *> &rdfs,
+               const std::vector<Curve *> &errors, unsigned int seed)
+{
+    if (config.SampledRDF()) {
+        ProfileScope scope("rdf sample");
+        RDFBudget budget;
+        budget.anchors = config.rdfanchors;
+        budget.seconds = config.rdftime;
+        budget.precision = config.rdfprecision;
+        SampleRDF(points, npoints, budget, rdfs, errors, seed);
+    } else {
+        ProfileScope scope("rdf");
+        EngineRDF(engines, points, npoints, rdfs);
+    }
+}
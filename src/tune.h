@@ -0,0 +1,99 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TUNE_H
+#define TUNE_H
+
+#include "config.h"
+#include "curve.h"
+#include "engine.h"
+#include "point.h"
+#include "spectrum.h"
+#include <new>
+#include <vector>
+
+// Replaces the engines of config.engines that are left to the autotuner by
+// the fastest ones for sets of npoints points. The choice is looked up in
+// config.tunecache by host, number of threads, the power of two buckets of
+// npoints and the spectrum size, and the RDF range and bin size. If there is
+// no entry, the candidates are timed on synthetic sets of the bucket size
+// once, fastest of several runs, and the choice is added to the file. Sizes
+// too large to time quickly are extrapolated from smaller ones.
+// Without a cache file, the choices last for the lifetime of the process.
+Engines TuneEngines(const Config &config, int npoints);
+
+// The stages computed with the given engines
+void EngineSpectrum(const Engines &engines, Spectrum *spectrum,
+                    const Point *points, int npoints);
+void EngineRDF(const Engines &engines, const Point *points, int npoints,
+               const std::vector<Curve *> &rdfs);
+// The RDFs with the given engines, or sampled if config sets any of the RDF
+// limits, with the standard errors in errors, see rdfsample.h
+void ConfigRDF(const Config &config, const Engines &engines,
+               const Point *points, int npoints,
+               const std::vector<Curve *> &rdfs,
+               const std::vector<Curve *> &errors, unsigned int seed = 1);
+
+// Runs a stage, noting in ok if it runs out of memory, as exceptions cannot
+// leave a task
+template <class F>
+inline void RunStage(F &stage, bool *ok)
+{
+    try {
+        stage();
+    } catch (std::bad_alloc &) {
+#ifdef _OPENMP
+#pragma omp atomic write
+#endif
+        *ok = false;
+    }
+}
+
+// Runs the FT, the RDFs and the spatial statistics of a set, any of which
+// may do nothing. They are independent, so they run as concurrent tasks. The
+// FT splits itself into further tasks, which soak up the threads left idle
+// by the serial stages. Returns false if a stage ran out of memory.
+template <class FT, class RDF, class Spatial>
+bool RunStages(FT ft, RDF rdf, Spatial spatial)
+{
+    bool ok = true;
+#ifdef _OPENMP
+#pragma omp parallel
+#pragma omp single
+#endif
+{
+#ifdef _OPENMP
+#pragma omp task
+#endif
+    RunStage(ft, &ok);
+#ifdef _OPENMP
+#pragma omp task
+#endif
+    RunStage(rdf, &ok);
+#ifdef _OPENMP
+#pragma omp task
+#endif
+    RunStage(spatial, &ok);
+}
+    return ok;
+}
+
+#endif  // TUNE_H
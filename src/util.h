@@ -28,6 +28,7 @@
 #include <cfloat>
 #include <cstdlib>
 #include <cstring>
+#include <sstream>
 #include <stdio.h>
 #include <string>
 #include <vector>
@@ -136,6 +137,23 @@ inline float j0f(float f) {
 
 
 // IO utility functions
+enum Endianness {
+    BigEndian, LittleEndian
+};
+
+inline Endianness SystemEndianness() {
+    union { unsigned int i; char c[sizeof(unsigned int)]; } e;
+    e.i = 1;
+    return e.c[0] == 0 ? BigEndian : LittleEndian;
+}
+
+template <typename T>
+inline void SwapEndian(T *values, int n) {
+    unsigned char *buf = reinterpret_cast<unsigned char *>(values);
+    for (int i = 0; i < n; ++i)
+        std::reverse(buf + i*sizeof(T), buf + (i+1)*sizeof(T));
+}
+
 inline std::string BaseName(std::string &fname, bool strip_suffix = false)
 {
     size_t found = fname.find_last_of("/\\");
@@ -148,6 +166,18 @@ inline std::string BaseName(std::string &fname, bool strip_suffix = false)
     return base;
 }
 
+// Splits a comma separated list, skipping empty items
+inline std::vector<std::string> SplitList(const std::string &s)
+{
+    std::vector<std::string> list;
+    std::istringstream iss(s);
+    std::string item;
+    while (std::getline(iss, item, ','))
+        if (!item.empty())
+            list.push_back(item);
+    return list;
+}
+
 inline int TerminalWidth() {
 #if defined(_WIN32) || defined(_WIN64) || defined(_MSC_VER)
     HANDLE h = GetStdHandle(STD_OUTPUT_HANDLE);
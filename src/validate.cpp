@@ -0,0 +1,940 @@
+/**
+ * This file is part of the point set analysis tool psa
+ *
+ * Copyright 2012
+ * Thomas Schlömer, thomas.schloemer@uni-konstanz.de
+ * Daniel Heck, daniel.heck@uni-konstanz.de
+ *
+ * psa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// psa-validate checks the alternative engines of psa against the reference
+// implementations on synthetic point sets. For every engine it reports the
+// maximum and RMS error of its results together with the speedup, and exits
+// with status 1 if any error exceeds the tolerance of the engine. The
+// gradients of the losses are checked against finite differences on small
+// sets, the incremental engines against the reference after random edits,
+// the chunked engines against the in-memory ones, the rings of banded grids
+// and of the polar RP against the full periodogram, the spectrum windows
+// against a direct sum in double precision, the spectrum at lists of
+// frequencies against the grid, the sampled RDF against the exact one within
+// its error bars, and the raster of large sets in summaries against a
+// supersampled one. All checks run twice:
+// serially, and as a task of a parallel region like the stages of
+// PsaContext, where the engines take their taskloop paths.
+
+#include "chunked.h"
+#include "config.h"
+#include "generate.h"
+#include "gradient.h"
+#include "incremental.h"
+#include "param.h"
+#include "periodogram.h"
+#include "polar.h"
+#include "profile.h"
+#include "rdfsample.h"
+#include "result.h"
+#include "statistics.h"
+#include "tiled.h"
+#include "util.h"
+#include <iostream>
+#include <random>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+static void Usage() {
+    std::cout << "usage: psa-validate [options]\n"
+        "  --help            show this message\n"
+        "  --generators l    comma separated list of uniform, jitter, hexagonal\n"
+        "                    and darts (default all)\n"
+        "  --n l             numbers of points (default 256,1024)\n"
+        "  --frange l        frequency ranges, see common/psa.cfg (default 5)\n"
+        "  --repeat n        runs per timing, the fastest counts (default 1)\n"
+        "  --seed n          seed of the generators (default 1)\n"
+    ;
+}
+
+// Maximum and RMS deviation of n values from the reference, relative to the
+// reference where its magnitude exceeds one, e.g. at the peaks of lattices
+struct Error {
+    double max, rms;
+    
+    Error(const float *ref, const float *alt, int n) {
+        max = rms = 0;
+        for (int i = 0; i < n; ++i) {
+            double d = fabs((double) alt[i] - ref[i]) /
+                       std::max(1.0, fabs((double) ref[i]));
+            if (d != d) d = HUGE_VAL;
+            max = std::max(max, d);
+            rms += d * d;
+        }
+        rms = n > 0 ? sqrt(rms / n) : 0;
+    }
+};
+
+struct Validator {
+    int repeat;
+    int checks, failures;
+    Generator generator;
+    int npoints;
+    bool tasks;
+    
+    // Runs f as a task of a parallel region of at least two threads in the
+    // tasks pass, and directly otherwise
+    template <class F>
+    void Run(F f) {
+#ifdef _OPENMP
+        if (tasks) {
+#pragma omp parallel num_threads(std::max(2, omp_get_max_threads()))
+#pragma omp single
+            f();
+            return;
+        }
+#endif
+        f();
+    }
+    
+    // Fastest of repeated runs of f, in seconds. The references are always
+    // computed serially.
+    template <class F>
+    double Time(F f, bool reference = false) {
+        double best = 0;
+        const bool wastasks = tasks;
+        tasks = tasks && !reference;
+        for (int i = 0; i < repeat; ++i) {
+            double t = Profile::Now();
+            Run(f);
+            t = Profile::Now() - t;
+            best = (i == 0) ? t : std::min(best, t);
+        }
+        tasks = wastasks;
+        return best;
+    }
+    
+    void Check(const char *engine, const char *quantity, const Error &e,
+               double tolerance, double speedup) {
+        bool ok = e.max <= tolerance;
+        printf("%-16s %-6s %-10s %6d  %-12s max %9.3g  rms %9.3g  tol %7.1g  "
+               "speedup %6.2f  %s\n", engine, tasks ? "tasks" : "serial",
+               GeneratorName(generator), npoints, quantity, e.max, e.rms,
+               tolerance, speedup, ok ? "ok" : "FAILED");
+        fflush(stdout);
+        ++checks;
+        if (!ok) ++failures;
+    }
+};
+
+// Tolerances of the alternative engines, in the units of the output: the
+// periodogram and RP relative to the power of a Poisson process, the
+// anisotropy in dB, the statistics in the normalized units of psa.
+// Engines that compute the same sums in a different order are held to float
+// round-off, engines with different arithmetic to their expected error.
+static const double FTPeriodogramTol = 1e-2;
+static const double FTCurveTol = 1e-3;
+static const double FTAnisotropyTol = 1e-2;
+static const double ExactTol = 1e-5;
+// Finite differences in float, relative to the largest component
+static const double GradientTol = 1e-3;
+// The second derivative of the RDF kernel jumps at its cutoff, where the
+// extrapolation of the differences fails
+static const double RDFGradientTol = 1e-2;
+
+static void ValidateSpectrum(Validator &v, const PointSet &set, float frange)
+{
+    const int n = set.size();
+    const float fnorm = 2.f / sqrtf(n);
+    const int ftsize = frange / fnorm;
+    const float fbinsize = DefaultConfig().fbinsize;
+    
+    Spectrum ref(ftsize * 2), alt(ftsize * 2);
+    double tref = v.Time([&]() {
+        Spectrum::PointSetSpectrum(&ref, &set.points[0], n);
+    }, true);
+    double talt = v.Time([&]() {
+        Spectrum::PointSetSpectrumSeparable(&alt, &set.points[0], n);
+    });
+    
+    Periodogram pref(ref), palt(alt);
+    pref.Divide(n);
+    palt.Divide(n);
+    Curve rpref(ftsize * fbinsize, 0, ftsize), rpalt(rpref);
+    Curve aniref(rpref), anialt(rpref);
+    pref.RadialPower(&rpref);
+    palt.RadialPower(&rpalt);
+    pref.Anisotropy(&aniref, rpref);
+    palt.Anisotropy(&anialt, rpalt);
+    
+    const double speedup = tref / std::max(talt, 1e-9);
+    v.Check("ft-separable", "periodogram",
+            Error(pref.periodogram, palt.periodogram, pref.size * pref.size),
+            FTPeriodogramTol, speedup);
+    v.Check("ft-separable", "rp", Error(&rpref.y[0], &rpalt.y[0], rpref.size()),
+            FTCurveTol, speedup);
+    v.Check("ft-separable", "ani",
+            Error(&aniref.y[0], &anialt.y[0], aniref.size()),
+            FTAnisotropyTol, speedup);
+}
+
+// The banded spectrum in bands of a third of the rows, so that the last one
+// is partial, against the rings of the full periodogram. The speedup is that
+// over the direct spectrum and the periodogram.
+static void ValidateTiled(Validator &v, const PointSet &set, float frange)
+{
+    const int n = set.size();
+    const float fnorm = 2.f / sqrtf(n);
+    const int ftsize = frange / fnorm;
+    const int size = ftsize * 2;
+    const float fbinsize = DefaultConfig().fbinsize;
+    
+    Curve rpref(ftsize * fbinsize, 0, ftsize), rpalt(rpref);
+    Curve aniref(rpref), anialt(rpref);
+    double tref = v.Time([&]() {
+        Spectrum ref(size);
+        Spectrum::PointSetSpectrum(&ref, &set.points[0], n);
+        Periodogram pref(ref);
+        pref.Divide(n);
+        pref.RadialPower(&rpref);
+        pref.Anisotropy(&aniref, rpref);
+    }, true);
+    double talt = v.Time([&]() {
+        TiledSpectrum tiled(size, std::max(1, size / 3));
+        tiled.Compute(&set.points[0], n, &rpalt, &anialt, NULL);
+    });
+    
+    const double speedup = tref / std::max(talt, 1e-9);
+    v.Check("ft-banded", "rp", Error(&rpref.y[0], &rpalt.y[0], rpref.size()),
+            FTCurveTol, speedup);
+    v.Check("ft-banded", "ani",
+            Error(&aniref.y[0], &anialt.y[0], aniref.size()),
+            FTAnisotropyTol, speedup);
+}
+
+// Frequencies sampled per ring of the polar RP, and the deviation of its
+// sampled rings from the grid, in standard errors of the sample
+static const int PolarAngles = 32;
+static const double PolarZTol = 5.0;
+
+// Deviations of the sampled RP and ANI from the reference, in standard errors
+// of a sample of maxangles of the frequencies of each ring of the periodogram
+// without replacement. The errors follow from the moments of the power in
+// each ring; those of the ANI are those of the variance and the mean of the
+// power propagated to the decibel, and floored by the float tolerances.
+static void PolarDeviations(const Periodogram &p, const Curve &rpref,
+                            const Curve &rpalt, const Curve &aniref,
+                            const Curve &anialt, int maxangles,
+                            std::vector<float> *zrp, std::vector<float> *zani)
+{
+    const int nrings = rpref.size(), size2 = p.size / 2;
+    std::vector<double> count(nrings, 0.), m2(nrings, 0.), m4(nrings, 0.);
+    for (int x = 0; x < p.size; ++x)
+        for (int y = 0; y < p.size; ++y) {
+            int cx = abs(x - size2), cy = abs(y - size2);
+            int i = rpref.ToIndex(sqrtf(cx*cx + cy*cy));
+            if (i >= nrings)
+                continue;
+            double d = p.periodogram[x + y*p.size] - rpref[i];
+            count[i]++;
+            m2[i] += d * d;
+            m4[i] += d * d * d * d;
+        }
+    zrp->assign(nrings, 0.f);
+    zani->assign(nrings, 0.f);
+    for (int i = 0; i < nrings; ++i) {
+        // Each frequency of the half plane stands for its mirror image
+        const double pop = std::max(1., 0.5 * count[i]);
+        const double k = std::min((double) maxangles, pop);
+        const double fpc = (pop > 1.) ? (pop - k) / (pop - 1.) : 0.;
+        const double var = m2[i] / std::max(1., count[i]);
+        const double var2 = m4[i] / std::max(1., count[i]) - var * var;
+        const double mean = std::max((double) fabsf(rpref[i]), 1e-30);
+        const double semean = sqrt(var / k * fpc);
+        const double sevar = sqrt(std::max(var2, 0.) / k * fpc);
+        const double seani = 10. / log(10.) *
+            sqrt(sevar * sevar / std::max(var * var, 1e-30) +
+                 4. * semean * semean / (mean * mean));
+        (*zrp)[i] = (rpalt[i] - rpref[i]) /
+            std::max(semean, FTCurveTol * std::max(1., mean));
+        const double ani = fabsf(aniref[i]);
+        (*zani)[i] = (anialt[i] - aniref[i]) /
+            std::max(seani, FTAnisotropyTol * std::max(1., ani));
+    }
+}
+
+// The polar RP with whole rings against the rings of the periodogram of the
+// direct spectrum, and with a sample of the rings against the errors of the
+// sample. The speedup is that over the direct spectrum and the periodogram.
+static void ValidatePolar(Validator &v, const PointSet &set, float frange)
+{
+    const int n = set.size();
+    const float fnorm = 2.f / sqrtf(n);
+    const int ftsize = frange / fnorm;
+    const float fbinsize = DefaultConfig().fbinsize;
+    
+    const Curve layout(ftsize * fbinsize, 0, ftsize);
+    Curve rpref(layout), aniref(layout);
+    Spectrum ref(ftsize * 2);
+    Periodogram pref;
+    double tref = v.Time([&]() {
+        Spectrum::PointSetSpectrum(&ref, &set.points[0], n);
+        pref = Periodogram(ref);
+        pref.Divide(n);
+        pref.RadialPower(&rpref);
+        pref.Anisotropy(&aniref, rpref);
+    }, true);
+    
+    const int whole = 4 * ftsize * ftsize;
+    const PolarSpectrum rings(layout, whole), sample(layout, PolarAngles);
+    Curve rpalt, anialt;
+    double talt = v.Time([&]() {
+        rings.Compute(&set.points[0], n, &rpalt, &anialt);
+    });
+    double speedup = tref / std::max(talt, 1e-9);
+    v.Check("polar-whole", "rp", Error(&rpref.y[0], &rpalt.y[0], rpref.size()),
+            FTCurveTol, speedup);
+    v.Check("polar-whole", "ani",
+            Error(&aniref.y[0], &anialt.y[0], aniref.size()),
+            FTAnisotropyTol, speedup);
+    
+    talt = v.Time([&]() {
+        sample.Compute(&set.points[0], n, &rpalt, &anialt);
+    });
+    speedup = tref / std::max(talt, 1e-9);
+    std::vector<float> zrp, zani, zero(layout.size(), 0.f);
+    PolarDeviations(pref, rpref, rpalt, aniref, anialt, PolarAngles, &zrp,
+                    &zani);
+    v.Check("polar-sampled", "rp z", Error(&zero[0], &zrp[0], zrp.size()),
+            PolarZTol, speedup);
+    v.Check("polar-sampled", "ani z", Error(&zero[0], &zani[0], zani.size()),
+            PolarZTol, speedup);
+}
+
+// Windows of the spectrum at fractions and multiples of the extent of the
+// grid, each given by its center and width in units of ftsize and the step
+// of its frequencies
+struct WindowCase {
+    const char *quantity;
+    float cx, cy, width, step;
+};
+
+static const WindowCase WindowCases[] = {
+    // Zoom in between the integer frequencies around the first peaks
+    { "zoom", 0.25f, 0.1f, 0.1f, 0.25f },
+    // High frequencies beyond frange, where the phases span many turns
+    { "far", 8.f, 5.f, 0.2f, 0.5f },
+};
+
+// Each engine of SpectrumWindow against a direct sum in double precision, as
+// the periodogram relative to the power of a Poisson process. The speedup is
+// that over the sum.
+static void ValidateWindow(Validator &v, const PointSet &set, float frange)
+{
+    const int n = set.size();
+    const float fnorm = 2.f / sqrtf(n);
+    const int ftsize = frange / fnorm;
+    const int engines[3] = { FTDirect, FTSeparable, EngineAuto };
+    const char *names[3] = { "window-direct", "window-separable",
+                             "window-auto" };
+    const int ncases = sizeof(WindowCases) / sizeof(WindowCases[0]);
+    
+    for (int c = 0; c < ncases; ++c) {
+        const WindowCase &w = WindowCases[c];
+        SpectrumWindow window(w.cx * ftsize, w.cy * ftsize, w.width * ftsize,
+                              w.width * ftsize, w.step);
+        const int nfreqs = window.nx * window.ny;
+        std::vector<float> ref(nfreqs), alt(nfreqs);
+        double tref = v.Time([&]() {
+            for (int j = 0; j < window.ny; ++j)
+                for (int i = 0; i < window.nx; ++i) {
+                    const double wx = window.FrequencyX(i);
+                    const double wy = window.FrequencyY(j);
+                    double re = 0., im = 0.;
+                    for (int k = 0; k < n; ++k) {
+                        double t = -2. * M_PI * (wx * set.points[k].x +
+                                                 wy * set.points[k].y);
+                        re += cos(t);
+                        im += sin(t);
+                    }
+                    ref[i + j*window.nx] = (re * re + im * im) / n;
+                }
+        }, true);
+        for (int e = 0; e < 3; ++e) {
+            double talt = v.Time([&]() {
+                SpectrumWindow::PointSetSpectrum(&window, &set.points[0], n,
+                                                 engines[e]);
+            });
+            for (int j = 0; j < window.ny; ++j)
+                for (int i = 0; i < window.nx; ++i)
+                    alt[i + j*window.nx] = window.Power(i, j) / n;
+            v.Check(names[e], w.quantity, Error(&ref[0], &alt[0], nfreqs),
+                    FTPeriodogramTol, tref / std::max(talt, 1e-9));
+        }
+    }
+}
+
+// Frequencies of the list, not a multiple of the blocks of four of the
+// engine, so that the last block is partial
+static const int FrequencyCount = 255;
+
+// The spectrum and power at a random list of frequencies of the grid against
+// the direct spectrum of the grid, relative to the power of a Poisson
+// process. The speedup is that over the whole grid.
+static void ValidateFrequencies(Validator &v, const PointSet &set,
+                                float frange)
+{
+    const int n = set.size();
+    const float fnorm = 2.f / sqrtf(n);
+    const int ftsize = frange / fnorm;
+    const int size = ftsize * 2;
+    
+    Spectrum grid(size);
+    double tref = v.Time([&]() {
+        Spectrum::PointSetSpectrum(&grid, &set.points[0], n);
+    }, true);
+    
+    std::mt19937 rng(n);
+    std::vector<Point> freqs(FrequencyCount);
+    std::vector<float> ftref(2 * FrequencyCount), ftalt(2 * FrequencyCount);
+    std::vector<float> pref(FrequencyCount), palt(FrequencyCount);
+    const float scale = 1.f / sqrtf(n);
+    for (int i = 0; i < FrequencyCount; ++i) {
+        const int x = rng() % size, y = rng() % size;
+        freqs[i] = Point(x - ftsize, y - ftsize);
+        const float re = grid.ft[2*(x + y*size)] * scale;
+        const float im = grid.ft[2*(x + y*size)+1] * scale;
+        ftref[2*i] = re;
+        ftref[2*i+1] = im;
+        pref[i] = re * re + im * im;
+    }
+    
+    double talt = v.Time([&]() {
+        Spectrum::PointSetFrequencies(&freqs[0], FrequencyCount,
+                                      &set.points[0], n, &ftalt[0]);
+    });
+    for (int i = 0; i < 2 * FrequencyCount; ++i)
+        ftalt[i] *= scale;
+    v.Check("ft-frequencies", "spectrum",
+            Error(&ftref[0], &ftalt[0], 2 * FrequencyCount), FTPeriodogramTol,
+            tref / std::max(talt, 1e-9));
+    
+    talt = v.Time([&]() {
+        Spectrum::PointSetPower(&freqs[0], FrequencyCount, &set.points[0], n,
+                                &palt[0]);
+    });
+    for (int i = 0; i < FrequencyCount; ++i)
+        palt[i] /= n;
+    v.Check("ft-frequencies", "power",
+            Error(&pref[0], &palt[0], FrequencyCount), FTPeriodogramTol,
+            tref / std::max(talt, 1e-9));
+}
+
+static void SpectralScalars(const Curve &rp, int npoints, float *scalars)
+{
+    Statistics stats;
+    RPStatistics(rp, npoints, &stats);
+    NormalizeStatistics(&stats, npoints);
+    scalars[0] = stats.effnyquist;
+    scalars[1] = stats.oscillations;
+}
+
+static void ValidateRDF(Validator &v, const PointSet &set)
+{
+    const int n = set.size();
+    const Config config = DefaultConfig();
+    const float rnorm = 1.f / sqrtf(2.f / (SQRT3 * n));
+    SpectralAverage spectral(n);
+    
+    // The short range RDF of the output, where the cell list pays off, and
+    // the full RDF of the spectral statistics, where it cannot
+    Curve rdfref(config.rbinsize * n, 0, config.rrange / rnorm), rdfalt(rdfref);
+    Curve fullref = spectral.RDFLayout(), fullalt = fullref;
+    std::vector<Curve *> refs(1, &rdfref), alts(1, &rdfalt);
+    double tref = v.Time([&]() { PointSet::RDF(&set.points[0], n, refs); },
+                         true);
+    double talt = v.Time([&]() {
+        PointSet::RDFCellList(&set.points[0], n, alts);
+    });
+    v.Check("rdf-cells", "rdf",
+            Error(&rdfref.y[0], &rdfalt.y[0], rdfref.size()), ExactTol,
+            tref / std::max(talt, 1e-9));
+    
+    refs.assign(1, &fullref);
+    alts.assign(1, &fullalt);
+    tref = v.Time([&]() { PointSet::RDF(&set.points[0], n, refs); }, true);
+    talt = v.Time([&]() { PointSet::RDFCellList(&set.points[0], n, alts); });
+    v.Check("rdf-cells", "full rdf",
+            Error(&fullref.y[0], &fullalt.y[0], fullref.size()), ExactTol,
+            tref / std::max(talt, 1e-9));
+    
+    // Both engines transform the reference RDF, so the differences of the
+    // RP and the statistics are those of the Hankel transform alone
+    Curve rpref(100 * sqrtf(n), 0, 0.5f * n), rpalt(rpref);
+    tref = v.Time([&]() { RDFtoRP(fullref, n, &rpref); }, true);
+    talt = v.Time([&]() { RDFtoRPWindowed(fullref, n, &rpalt); });
+    const double speedup = tref / std::max(talt, 1e-9);
+    v.Check("hankel-windowed", "rp",
+            Error(&rpref.y[0], &rpalt.y[0], rpref.size()), ExactTol, speedup);
+    float sref[2], salt[2];
+    SpectralScalars(rpref, n, sref);
+    SpectralScalars(rpalt, n, salt);
+    v.Check("hankel-windowed", "statistics", Error(sref, salt, 2), ExactTol,
+            speedup);
+}
+
+// Fraction of the points drawn as anchors of the sampled RDF, and the
+// deviation of its estimate from the exact RDF, in its standard errors
+static const int SampleFraction = 4;
+static const double SampleZTol = 5.0;
+// RMS of the deviations in standard errors; about one if the errors are
+// neither too small nor too large
+static const double SampleRMSTol = 0.5;
+
+// The sampled RDF with every point as an anchor against the exact RDF, and
+// with a sample of the points against the standard errors it reports, which
+// then have to account for the deviations from the exact RDF. The speedup is
+// that over the exact RDF.
+static void ValidateSampledRDF(Validator &v, const PointSet &set)
+{
+    const int n = set.size();
+    const Config config = DefaultConfig();
+    const float rnorm = 1.f / sqrtf(2.f / (SQRT3 * n));
+    
+    Curve ref(config.rbinsize * n, 0, config.rrange / rnorm);
+    Curve alt(ref), err(ref);
+    std::vector<Curve *> refs(1, &ref), alts(1, &alt), errs(1, &err);
+    double tref = v.Time([&]() { PointSet::RDF(&set.points[0], n, refs); },
+                         true);
+    RDFBudget budget;
+    double talt = v.Time([&]() {
+        SampleRDF(&set.points[0], n, budget, alts, errs);
+    });
+    std::vector<float> zero(ref.size(), 0.f);
+    double speedup = tref / std::max(talt, 1e-9);
+    v.Check("rdf-sampled", "all rdf", Error(&ref.y[0], &alt.y[0], ref.size()),
+            ExactTol, speedup);
+    v.Check("rdf-sampled", "all error", Error(&zero[0], &err.y[0], err.size()),
+            ExactTol, speedup);
+    
+    budget.anchors = std::max(1, n / SampleFraction);
+    talt = v.Time([&]() {
+        SampleRDF(&set.points[0], n, budget, alts, errs);
+    });
+    speedup = tref / std::max(talt, 1e-9);
+    std::vector<float> z;
+    for (int i = 0; i < ref.size(); ++i) {
+        // Bins without pairs in the sample have no error to compare with
+        if (err[i] > 0.f)
+            z.push_back((alt[i] - ref[i]) / err[i]);
+        else if (fabsf(alt[i] - ref[i]) > ExactTol * std::max(1.f, ref[i]))
+            z.push_back(HUGE_VALF);
+    }
+    double rms = 0.;
+    for (size_t i = 0; i < z.size(); ++i)
+        rms += (double) z[i] * z[i];
+    float zrms = z.empty() ? 1.f : sqrt(rms / z.size()), one = 1.f;
+    v.Check("rdf-sampled", "rdf z", Error(&zero[0], &z[0], z.size()),
+            SampleZTol, speedup);
+    v.Check("rdf-sampled", "z rms", Error(&one, &zrms, 1), SampleRMSTol,
+            speedup);
+}
+
+// Random inserts, removes and moves of points of an incremental engine,
+// e.g. IncrementalSpectrum. The same seed gives the same edits.
+static const int IncrementalEdits = 256;
+
+template <class T>
+static void RandomEdits(T *engine, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    for (int i = 0; i < IncrementalEdits; ++i) {
+        const int n = engine->NumPoints();
+        const int kind = rng() % 3;
+        if (kind == 0 || n < 2) {
+            engine->Insert(Point(u(rng), u(rng)));
+        } else if (kind == 1) {
+            engine->Remove(rng() % n);
+        } else {
+            const int index = rng() % n;
+            engine->Move(index, Point(u(rng), u(rng)));
+        }
+    }
+}
+
+// The speedup is that of an edit over a recompute of the reference
+static void ValidateIncrementalSpectrum(Validator &v, const PointSet &set,
+                                        float frange)
+{
+    Config config = DefaultConfig();
+    config.frange = frange;
+    IncrementalSpectrum incr(config, set.size());
+    double tedits = HUGE_VAL;
+    v.Time([&]() {
+        incr.Assign(&set.points[0], set.size());
+        double t = Profile::Now();
+        RandomEdits(&incr, set.size());
+        tedits = std::min(tedits, Profile::Now() - t);
+    });
+    
+    const std::vector<Point> &points = incr.GetPoints();
+    const Periodogram &palt = incr.GetPeriodogram();
+    const Curve &rpalt = incr.RadialPower();
+    Spectrum ref(palt.size);
+    double tref = v.Time([&]() {
+        Spectrum::PointSetSpectrum(&ref, &points[0], points.size());
+    }, true);
+    Periodogram pref(ref);
+    pref.Divide(points.size());
+    Curve rpref(rpalt);
+    pref.RadialPower(&rpref);
+    
+    const double speedup = tref * IncrementalEdits / std::max(tedits, 1e-9);
+    v.Check("incr-spectrum", "periodogram",
+            Error(pref.periodogram, palt.periodogram, pref.size * pref.size),
+            FTPeriodogramTol, speedup);
+    v.Check("incr-spectrum", "rp", Error(&rpref.y[0], &rpalt.y[0], rpref.size()),
+            FTCurveTol, speedup);
+}
+
+// Both the short range RDF, through the cell list, and the full RDF
+static void ValidateIncrementalRDF(Validator &v, const PointSet &set)
+{
+    const int n = set.size();
+    const Config config = DefaultConfig();
+    const float rnorm = 1.f / sqrtf(2.f / (SQRT3 * n));
+    std::vector<Curve> layouts;
+    layouts.push_back(Curve(config.rbinsize * n, 0, config.rrange / rnorm));
+    layouts.push_back(SpectralAverage(n).RDFLayout());
+    const char *quantities[2] = { "rdf", "full rdf" };
+    
+    for (int k = 0; k < 2; ++k) {
+        IncrementalRDF incr(layouts[k]);
+        double tedits = HUGE_VAL;
+        v.Time([&]() {
+            incr.Assign(&set.points[0], n);
+            double t = Profile::Now();
+            RandomEdits(&incr, n);
+            tedits = std::min(tedits, Profile::Now() - t);
+        });
+        
+        const std::vector<Point> &points = incr.GetPoints();
+        const Curve &alt = incr.GetRDF();
+        Curve ref(layouts[k]);
+        std::vector<Curve *> refs(1, &ref);
+        double tref = v.Time([&]() {
+            PointSet::RDF(&points[0], points.size(), refs);
+        }, true);
+        v.Check("incr-rdf", quantities[k],
+                Error(&ref.y[0], &alt.y[0], ref.size()), ExactTol,
+                tref * IncrementalEdits / std::max(tedits, 1e-9));
+    }
+}
+
+// The chunked engines read the set from a temporary file in blocks of a
+// quarter of the points, and are compared with the in-memory engines they
+// reproduce. The speedup is that over the in-memory engine.
+static void ValidateChunked(Validator &v, const PointSet &set, float frange)
+{
+    const int n = set.size();
+    const char *tmpdir = getenv("TMPDIR");
+    std::string fname = std::string(tmpdir ? tmpdir : "/tmp") +
+                        "/psa-validate-XXXXXX.rps";
+    int fd = mkstemps(&fname[0], 4);
+    if (fd < 0) {
+        std::cerr << "Cannot create '" << fname << "'.\n";
+        exit(1);
+    }
+    close(fd);
+    PointSet(set).Save(fname);
+    PointBlockReader reader;
+    if (!reader.Open(fname)) {
+        std::cerr << "Cannot read '" << fname << "'.\n";
+        exit(1);
+    }
+    const int chunk = std::max(1, n / 4);
+    bool ok = true;
+    
+    const float fnorm = 2.f / sqrtf(n);
+    const int ftsize = frange / fnorm;
+    Spectrum ref(ftsize * 2), alt(ftsize * 2);
+    double tref = v.Time([&]() {
+        Spectrum::PointSetSpectrumSeparable(&ref, &set.points[0], n);
+    }, true);
+    double talt = v.Time([&]() { ok &= ChunkedSpectrum(reader, chunk, &alt); });
+    Periodogram pref(ref), palt(alt);
+    v.Check("chunked-ft", "periodogram",
+            Error(pref.periodogram, palt.periodogram, pref.size * pref.size),
+            ExactTol, tref / std::max(talt, 1e-9));
+    
+    const Config config = DefaultConfig();
+    const float rnorm = 1.f / sqrtf(2.f / (SQRT3 * n));
+    Curve layouts[2] = {
+        Curve(config.rbinsize * n, 0, config.rrange / rnorm),
+        SpectralAverage(n).RDFLayout()
+    };
+    const char *quantities[2] = { "rdf", "full rdf" };
+    for (int k = 0; k < 2; ++k) {
+        Curve rdfref(layouts[k]), rdfalt(layouts[k]);
+        std::vector<Curve *> refs(1, &rdfref), alts(1, &rdfalt);
+        tref = v.Time([&]() {
+            PointSet::RDFCellList(&set.points[0], n, refs);
+        }, true);
+        talt = v.Time([&]() { ok &= ChunkedRDF(reader, chunk, alts); });
+        v.Check("chunked-rdf", quantities[k],
+                Error(&rdfref.y[0], &rdfalt.y[0], rdfref.size()), ExactTol,
+                tref / std::max(talt, 1e-9));
+    }
+    
+    reader.Close();
+    remove(fname.c_str());
+    if (!ok) {
+        std::cerr << "Cannot read '" << fname << "'.\n";
+        exit(1);
+    }
+}
+
+// Summaries rasterize large sets into a bitmap of twice the resolution of
+// the vector output, whose circles cover each pixel by the fraction of its
+// area inside them; the reference estimates that from a grid of samples
+static const int RasterPoints = 4096;
+static const int RasterSize = 512;
+static const float RasterRadius = 4.f;
+static const int RasterSamples = 8;
+// The raster samples 4 x 4 points per pixel, which misses up to a row of
+// samples where an edge runs along it
+static const double RasterTol = 0.3;
+
+static void ValidateRaster(Validator &v, const PointSet &set)
+{
+    const int res = RasterSize, sres = res * RasterSamples;
+    const float sradius = RasterRadius * RasterSamples;
+    std::vector<float> ref(res * res), alt;
+    double tref = v.Time([&]() {
+        std::vector<unsigned char> inside(sres * sres, 0);
+        for (int i = 0; i < set.size(); ++i) {
+            const float cx = set.points[i].x * sres;
+            const float cy = set.points[i].y * sres;
+            const int y0 = std::max(0, (int) floorf(cy - sradius));
+            const int y1 = std::min(sres - 1, (int) ceilf(cy + sradius));
+            for (int y = y0; y <= y1; ++y) {
+                const float dy = y + 0.5f - cy;
+                if (dy * dy > sradius * sradius)
+                    continue;
+                const float w = sqrtf(sradius * sradius - dy * dy);
+                const int x0 = std::max(0, (int) ceilf(cx - w - 0.5f));
+                const int x1 = std::min(sres - 1, (int) floorf(cx + w - 0.5f));
+                for (int x = x0; x <= x1; ++x)
+                    inside[x + y*sres] = 1;
+            }
+        }
+        std::fill(ref.begin(), ref.end(), 0.f);
+        for (int y = 0; y < sres; ++y)
+            for (int x = 0; x < sres; ++x)
+                ref[x / RasterSamples + (y / RasterSamples) * res] +=
+                    inside[x + y*sres];
+        for (int i = 0; i < res * res; ++i)
+            ref[i] /= RasterSamples * RasterSamples;
+    }, true);
+    double talt = v.Time([&]() {
+        RasterizePoints(set, res, RasterRadius, &alt);
+    });
+    v.Check("points-raster", "coverage", Error(&ref[0], &alt[0], res * res),
+            RasterTol, tref / std::max(talt, 1e-9));
+}
+
+// Points of the sets for the finite differences, and coordinates differenced
+static const int GradientPoints = 64;
+static const int GradientCoords = 16;
+static const float GradientStep = 2e-3f;
+// Range, bins and kernel width of the RDF loss, in mean point distances
+static const float RDFLossRange = 2.5f;
+static const int RDFLossBins = 20;
+static const float RDFLossSigma = 0.25f;
+
+// Central differences of loss(points, gradient) against its gradient, over
+// the first coordinates that stay inside the unit square when stepped. The
+// differences are extrapolated from steps h and h/2 to cancel their O(h^2)
+// error, and the errors are relative to the largest component, as the float
+// round-off of the loss swamps small ones. The speedup is that over the
+// finite differences of all coordinates.
+template <class L>
+static void CheckGradient(Validator &v, const char *engine, const PointSet &set,
+                          double tolerance, L loss)
+{
+    const int n = set.size();
+    std::vector<Point> points(set.points);
+    std::vector<float> gradient(2 * n);
+    double tgrad = v.Time([&]() { loss(&points[0], &gradient[0]); });
+    double tloss = v.Time([&]() { loss(&points[0], NULL); }, true);
+    
+    const float h = GradientStep;
+    std::vector<float> fd, alt;
+    float scale = 0.f;
+    for (int i = 0; i < 2 * n && (int) fd.size() < GradientCoords; ++i) {
+        float &c = (i % 2 == 0) ? points[i/2].x : points[i/2].y;
+        const float c0 = c;
+        if (c0 < h || c0 > 1.f - h)
+            continue;
+        float d[2];
+        for (int k = 0; k < 2; ++k) {
+            const float step = h / (1 << k);
+            c = c0 + step;
+            const float lp = loss(&points[0], NULL);
+            c = c0 - step;
+            const float lm = loss(&points[0], NULL);
+            d[k] = (lp - lm) / (2.f * step);
+        }
+        c = c0;
+        fd.push_back((4.f * d[1] - d[0]) / 3.f);
+        alt.push_back(gradient[i]);
+        scale = std::max(scale, fabsf(fd.back()));
+    }
+    for (unsigned int i = 0; i < fd.size(); ++i) {
+        fd[i] /= std::max(scale, 1e-30f);
+        alt[i] /= std::max(scale, 1e-30f);
+    }
+    v.Check(engine, "gradient", Error(&fd[0], &alt[0], fd.size()),
+            tolerance, 4.0 * n * tloss / std::max(tgrad, 1e-9));
+}
+
+static void ValidateLosses(Validator &v, const PointSet &set, float frange)
+{
+    const int n = set.size();
+    const float fnorm = 2.f / sqrtf(n);
+    const int ftsize = frange / fnorm;
+    const int size = 2 * ftsize;
+    const float fbinsize = DefaultConfig().fbinsize;
+    
+    // Targets of a Poisson process
+    std::vector<float> target(size * size, 1.f), weights(size * size, 1.f);
+    CheckGradient(v, "loss-spectral", set, GradientTol,
+                  [&](const Point *points, float *gradient) {
+        return SpectralLoss(points, n, size, &target[0], &weights[0], gradient);
+    });
+    
+    RingTarget rings;
+    rings.rp = Curve(ftsize * fbinsize, 0, ftsize);
+    rings.rp.y.assign(rings.rp.size(), 1.f);
+    rings.rpweights = rings.ani = rings.aniweights = rings.rp;
+    rings.ani.SetZero();
+    CheckGradient(v, "loss-ring", set, GradientTol,
+                  [&](const Point *points, float *gradient) {
+        return RingLoss(points, n, rings, gradient);
+    });
+}
+
+static void ValidateRDFLoss(Validator &v, const PointSet &set)
+{
+    const int n = set.size();
+    const float rnorm = 1.f / sqrtf(2.f / (SQRT3 * n));
+    
+    // Target of a Poisson process over the short range the loss is meant for,
+    // as the full RDF of a small set has gradients below the float round-off
+    // of the loss
+    RDFTarget target;
+    target.rdf = Curve(RDFLossBins, 0, RDFLossRange / rnorm);
+    target.rdf.y.assign(target.rdf.size(), 1.f);
+    target.sigma = RDFLossSigma / rnorm;
+    CheckGradient(v, "loss-rdf", set, RDFGradientTol,
+                  [&](const Point *points, float *gradient) {
+        return RDFLoss(points, n, target, gradient);
+    });
+}
+
+int main(int argc, char * const argv[])
+{
+    ParamList params;
+    params.Define("help", "false");
+    params.Define("generators", "uniform,jitter,hexagonal,darts");
+    params.Define("n", "256,1024");
+    params.Define("frange", "5");
+    params.Define("repeat", "1");
+    params.Define("seed", "1");
+    
+    std::vector<std::string> args;
+    params.Parse(argc, argv, args);
+    bool show_usage = params.GetBool("help") || !args.empty();
+    if (const Param *p = params.UnusedOption()) {
+        fprintf(stderr, "Unknown option '%s'.\n", p->name.c_str());
+        show_usage = true;
+    }
+    if (show_usage) {
+        Usage();
+        exit(0);
+    }
+    
+    std::vector<Generator> generators;
+    std::vector<std::string> names = SplitList(params.GetString("generators"));
+    for (unsigned int i = 0; i < names.size(); ++i) {
+        Generator g;
+        if (!ParseGenerator(names[i], &g)) {
+            std::cerr << "Unknown generator '" << names[i] << "'.\n";
+            exit(1);
+        }
+        generators.push_back(g);
+    }
+    std::vector<int> npoints;
+    std::vector<float> franges;
+    names = SplitList(params.GetString("n"));
+    for (unsigned int i = 0; i < names.size(); ++i)
+        npoints.push_back(std::max(2, atoi(names[i].c_str())));
+    names = SplitList(params.GetString("frange"));
+    for (unsigned int i = 0; i < names.size(); ++i)
+        franges.push_back(std::max(atof(names[i].c_str()), 1.0));
+    
+    Validator v;
+    v.repeat = std::max(1, params.GetInt("repeat"));
+    v.checks = v.failures = 0;
+    unsigned int seed = params.GetInt("seed");
+    for (int pass = 0; pass < 2; ++pass) {
+        v.tasks = (pass == 1);
+        for (unsigned int g = 0; g < generators.size(); ++g) {
+            PointSet small;
+            GeneratePoints(generators[g], GradientPoints, seed, &small);
+            v.generator = generators[g];
+            v.npoints = GradientPoints;
+            for (unsigned int f = 0; f < franges.size(); ++f)
+                ValidateLosses(v, small, franges[f]);
+            ValidateRDFLoss(v, small);
+            PointSet raster;
+            GeneratePoints(generators[g], RasterPoints, seed, &raster);
+            v.npoints = RasterPoints;
+            ValidateRaster(v, raster);
+            for (unsigned int i = 0; i < npoints.size(); ++i) {
+                PointSet set;
+                GeneratePoints(generators[g], npoints[i], seed, &set);
+                v.generator = generators[g];
+                v.npoints = npoints[i];
+                ValidateRDF(v, set);
+                ValidateIncrementalRDF(v, set);
+                ValidateSampledRDF(v, set);
+                for (unsigned int f = 0; f < franges.size(); ++f) {
+                    ValidateSpectrum(v, set, franges[f]);
+                    ValidateTiled(v, set, franges[f]);
+                    ValidatePolar(v, set, franges[f]);
+                    ValidateWindow(v, set, franges[f]);
+                    ValidateFrequencies(v, set, franges[f]);
+                    ValidateIncrementalSpectrum(v, set, franges[f]);
+                    ValidateChunked(v, set, franges[f]);
+                }
+            }
+        }
+    }
+    
+    printf("%d of %d checks failed\n", v.failures, v.checks);
+    return v.failures > 0 ? 1 : 0;
+}